@@ -0,0 +1,367 @@
+/*
+    自适应定时器：升序链表、时间轮、时间堆哪一个最快，取决于定时器的数目和超时时间的分布，而这两者在白天
+    和夜间的流量下并不相同。自适应定时器对调用者只暴露一套接口（add_timer、adjust_timer、del_timer、tick），
+    内部持有三种引擎，同一时刻只使用其中一种，并在运行中统计定时器数目和超时时间的跨度：
+
+        定时器很少（不超过LIST_MAX个）时使用升序链表，它的tick只看表头，插入时的线性扫描也很短；
+        定时器较多且几乎都在时间轮一周之内到期时使用时间轮，插入和删除都是O(1)；
+        有相当一部分定时器超出时间轮一周时使用时间堆，避免它们在时间轮上反复转圈。
+
+    每EVAL_TICKS次tick评估一次，同一个结论连续出现STABLE_EVALS次才真正切换，避免在边界附近来回迁移。
+    切换时沿着所有定时器组成的链表把它们逐个从旧引擎摘下、按剩余时间加入新引擎，调用者持有的
+    adaptive_timer指针始终有效，不会察觉到迁移。
+
+    tick应当每隔time_wheel::interval()秒被调用一次。
+
+    从执行效率来看：
+        添加、删除、执行一个定时器的时间复杂度与当前引擎相同
+        切换引擎的代价为O(n)（切换到时间堆时为O(nlogn)），只在负载特征稳定改变后发生
+*/
+
+#ifndef ADAPTIVE_TIMER_HPP
+#define ADAPTIVE_TIMER_HPP
+
+#include <time.h>
+#include "lst_timer.hpp"
+#include "time_heap_timer.hpp"
+#include "time_wheel_timer.hpp"
+#include "timer_clock.hpp"
+#include "timer_pool.hpp"
+#include "timer_stats.hpp"
+#include "timer_traits.hpp"
+
+template <typename T>
+class adaptive_timer_mgr;
+
+// 定时器类
+template <typename T>
+class adaptive_timer
+{
+public:
+    adaptive_timer() : period(0), owner(nullptr), node(nullptr), prev(nullptr), next(nullptr) {}
+
+    // 节点从线程本地的内存池中分配
+    static void* operator new(size_t size) { return timer_pool::allocate(size); }
+    static void operator delete(void* p, size_t size) { timer_pool::release(p, size); }
+public:
+    time_t expire;                      // 定时器生效的绝对时间
+    time_t period;                      // 周期定时器的重复间隔（秒），为0表示一次性定时器
+    void (*cb_func)(T);                 // 定时器回调函数
+    T user_data;                        // 用户数据
+    adaptive_timer_mgr<T>* owner;       // 定时器所属的自适应定时器
+    void* node;                         // 定时器在当前引擎中对应的节点
+    adaptive_timer* prev;               // 所有定时器组成的链表中的前一个
+    adaptive_timer* next;               // 所有定时器组成的链表中的后一个
+};
+
+// 自适应定时器
+template <typename T>
+class adaptive_timer_mgr
+{
+public:
+    typedef adaptive_timer<T> timer_type;
+
+    // 可供选择的引擎
+    enum backend_type
+    {
+        BACKEND_LIST,
+        BACKEND_WHEEL,
+        BACKEND_HEAP
+    };
+
+    adaptive_timer_mgr()
+        : heap(64), backend(BACKEND_LIST), head(nullptr), count(0), ticks(0),
+          window_adds(0), window_far(0), candidate(BACKEND_LIST), stable(0) {}
+
+    // 各个引擎只销毁它们自己的节点，自适应定时器本身在这里销毁
+    ~adaptive_timer_mgr()
+    {
+        while(head)
+        {
+            del_timer(head);
+        }
+    }
+
+    // 添加目标定时器，调用者事先填好它的超时时间expire
+    void add_timer(timer_type* timer)
+    {
+        if(!timer)
+        {
+            return;
+        }
+        time_t cur = timer_now();
+        timer->owner = this;
+        timer->prev = nullptr;
+        timer->next = head;
+        if(head)
+        {
+            head->prev = timer;
+        }
+        head = timer;
+        ++count;
+        stats.on_add();
+        observe(timer, cur);
+        schedule(timer, cur);
+    }
+
+    // 删除目标定时器
+    void del_timer(timer_type* timer)
+    {
+        // 回调函数为空的定时器正在执行它的一次性任务，已经离开后端和定时器链表，由tick负责销毁
+        if(!timer || !timer->cb_func)
+        {
+            return;
+        }
+        stats.on_cancel();
+        unschedule(timer);
+        unlink(timer);
+        delete timer;
+    }
+
+    // 调用者修改了timer->expire之后调用该函数重新安排定时器
+    void adjust_timer(timer_type* timer)
+    {
+        if(!timer)
+        {
+            return;
+        }
+        time_t cur = timer_now();
+        unschedule(timer);
+        observe(timer, cur);
+        schedule(timer, cur);
+    }
+
+    // 心搏函数，每隔time_wheel::interval()秒调用一次
+    void tick()
+    {
+        timer_stats::tick_scope scope(stats);
+        switch(backend)
+        {
+        case BACKEND_LIST:
+            lst.tick();
+            break;
+        case BACKEND_WHEEL:
+            wheel.tick();
+            break;
+        case BACKEND_HEAP:
+            heap.tick();
+            break;
+        }
+        if(++ticks % EVAL_TICKS == 0)
+        {
+            evaluate();
+        }
+        stats.set_tombstones(heap.dead_size());
+    }
+
+    // 当前使用的引擎
+    backend_type current_backend() const
+    {
+        return backend;
+    }
+
+    // 立即切换到指定的引擎
+    void switch_to(backend_type target)
+    {
+        if(target == backend)
+        {
+            return;
+        }
+        time_t cur = timer_now();
+        for(timer_type* tmp = head; tmp; tmp = tmp->next)
+        {
+            unschedule(tmp);
+        }
+        // 撤出时间堆后其中只剩下被延迟销毁的节点，数目不足以触发compact，在这里一并销毁并归还堆数组
+        if(backend == BACKEND_HEAP)
+        {
+            heap.shrink_to_fit();
+            stats.set_tombstones(heap.dead_size());
+        }
+        backend = target;
+        for(timer_type* tmp = head; tmp; tmp = tmp->next)
+        {
+            schedule(tmp, cur);
+        }
+    }
+
+    int size() const
+    {
+        return count;
+    }
+
+    // 运行统计的快照，槽的长度取自内部的时间轮
+    timer_stats_snapshot get_stats() const
+    {
+        timer_stats_snapshot s = stats.snapshot();
+        s.max_slot_len = wheel.get_stats().max_slot_len;
+        return s;
+    }
+
+private:
+    typedef sort_timer_lst<timer_type*> list_engine;
+    typedef time_wheel<timer_type*> wheel_engine;
+    typedef time_heap<timer_type*> heap_engine;
+
+    static const int LIST_MAX = 64;         // 定时器不超过这个数目时使用升序链表
+    static const int EVAL_TICKS = 16;       // 每隔多少次tick评估一次
+    static const int STABLE_EVALS = 4;      // 同一结论连续出现多少次才切换
+
+    // 记录新加入或调整的定时器是否超出了时间轮一周
+    void observe(const timer_type* timer, time_t cur)
+    {
+        ++window_adds;
+        if(timer->expire - cur >= wheel_engine::horizon())
+        {
+            ++window_far;
+        }
+    }
+
+    // 根据定时器数目和最近一个评估周期内超时时间的分布选择引擎
+    void evaluate()
+    {
+        backend_type best = BACKEND_LIST;
+        if(count > LIST_MAX)
+        {
+            // 超过1/8的新定时器在时间轮一周之外时，它们的转圈开销就不可忽略了
+            best = window_far * 8 > window_adds ? BACKEND_HEAP : BACKEND_WHEEL;
+        }
+        window_adds = window_far = 0;
+        if(best == backend)
+        {
+            stable = 0;
+            return;
+        }
+        if(best != candidate)
+        {
+            candidate = best;
+            stable = 0;
+        }
+        if(++stable >= STABLE_EVALS)
+        {
+            stable = 0;
+            switch_to(best);
+        }
+    }
+
+    // 把定时器按剩余时间加入当前引擎
+    void schedule(timer_type* timer, time_t cur)
+    {
+        time_t delay = timer->expire - cur;
+        int timeout = delay > 0 ? static_cast<int>(delay) : 0;
+        switch(backend)
+        {
+        case BACKEND_LIST:
+            timer->node = timer_traits<list_engine>::add_timer(lst, timeout, &adaptive_timer_mgr::fire, timer);
+            break;
+        case BACKEND_WHEEL:
+            timer->node = timer_traits<wheel_engine>::add_timer(wheel, timeout, &adaptive_timer_mgr::fire, timer);
+            break;
+        case BACKEND_HEAP:
+            timer->node = timer_traits<heap_engine>::add_timer(heap, timeout, &adaptive_timer_mgr::fire, timer);
+            break;
+        }
+    }
+
+    // 把定时器从当前引擎中摘下
+    void unschedule(timer_type* timer)
+    {
+        if(!timer->node)
+        {
+            return;
+        }
+        switch(backend)
+        {
+        case BACKEND_LIST:
+            lst.del_timer(static_cast<util_timer<timer_type*>*>(timer->node));
+            break;
+        case BACKEND_WHEEL:
+            wheel.del_timer(static_cast<tw_timer<timer_type*>*>(timer->node));
+            break;
+        case BACKEND_HEAP:
+            heap.del_timer(static_cast<heap_timer<timer_type*>*>(timer->node));
+            break;
+        }
+        timer->node = nullptr;
+    }
+
+    // 把定时器从所有定时器组成的链表中摘下
+    void unlink(timer_type* timer)
+    {
+        if(timer->prev)
+        {
+            timer->prev->next = timer->next;
+        }
+        else
+        {
+            head = timer->next;
+        }
+        if(timer->next)
+        {
+            timer->next->prev = timer->prev;
+        }
+        --count;
+    }
+
+    // 引擎中的定时器到期，引擎随后会销毁它自己的节点
+    static void fire(timer_type* timer)
+    {
+        adaptive_timer_mgr* self = timer->owner;
+        timer->node = nullptr;
+        // 周期定时器以新的超时时间交给当前的后端重新安排
+        if(timer->period > 0)
+        {
+            time_t cur = timer_now();
+            timer->expire = timer_next_expire(timer->expire, timer->period, cur);
+            self->schedule(timer, cur);
+            self->stats.on_fire(true);
+            timer->cb_func(timer->user_data);
+            return;
+        }
+        self->unlink(timer);
+        // 先清空回调函数再执行，回调函数中对它自己调用del_timer就成了空操作
+        void (*cb)(T) = timer->cb_func;
+        timer->cb_func = nullptr;
+        self->stats.on_fire(false);
+        cb(timer->user_data);
+        delete timer;
+    }
+
+private:
+    list_engine lst;                // 升序链表引擎
+    wheel_engine wheel;             // 时间轮引擎
+    heap_engine heap;               // 时间堆引擎
+    backend_type backend;           // 当前使用的引擎
+    timer_type* head;               // 所有定时器组成的链表
+    int count;                      // 定时器数目
+    unsigned long ticks;            // tick被调用的次数
+    int window_adds;                // 本评估周期内加入或调整的定时器数目
+    int window_far;                 // 其中超出时间轮一周的数目
+    backend_type candidate;         // 最近一次评估建议切换到的引擎
+    int stable;                     // candidate连续出现的次数
+    timer_stats stats;              // 运行统计
+};
+
+// 自适应定时器的统一适配接口
+template <typename T>
+struct timer_traits<adaptive_timer_mgr<T> >
+{
+    typedef adaptive_timer<T> timer_type;
+
+    static timer_type* add_timer(adaptive_timer_mgr<T>& mgr, int timeout, void (*cb)(T), T data)
+    {
+        timer_type* timer = new timer_type;
+        timer->expire = timer_now() + timeout;
+        timer->cb_func = cb;
+        timer->user_data = data;
+        mgr.add_timer(timer);
+        return timer;
+    }
+
+    static void del_timer(adaptive_timer_mgr<T>& mgr, timer_type* timer)
+    {
+        mgr.del_timer(timer);
+    }
+};
+
+#endif
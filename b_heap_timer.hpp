@@ -0,0 +1,306 @@
+/*
+    分页时间堆（B-heap）：时间堆的数组按层存放，第d层的元素集中在下标2^d-1附近。堆中有数千万个定时器时，
+    下虑到下面几层每一层都落在一个新的内存页上，除了缓存未命中还有TLB未命中。分页时间堆仍然是同一棵
+    二叉最小堆，只是换了一种存放方式：把树按每K层切成一段，每段中以某个节点为根、高为K的子树整个放在
+    一个4KB的页内。K=8时一棵子树有255个节点，每个元素16字节，恰好放进一页（最后一个位置空置）。这样从
+    根到叶子的一次下虑只经过深度/8个页，而不是深度减去12个左右的页。
+
+    分段从叶子一层往上对齐：最下面的段总是完整的K层，层数不足K的是最上面那一段，它只有一页，总在缓存中。
+    如果从根往下分段，最下面一段往往只用到每页的前几层，叶子分散在大量几乎空着的页上，反而比时间堆访问
+    更多的页。树每长高一层，数组扩容时就按新的分段重新排列一次，代价与扩容时的复制相同。
+
+    节点的逻辑下标与时间堆相同（孩子是2i+1和2i+2），上虑和下虑的算法不变，访问数组时通过phys()把逻辑
+    下标换算成物理下标；逐层移动时物理下标可以直接由上一层推出，只在跨越段的边界时才完整换算。
+
+    key、延迟销毁和定时器组的处理都与时间堆相同，定时器节点沿用heap_timer，删除、压缩和tick都继承自
+    lazy_heap_base。
+
+    从执行效率来看：
+        添加一个定时器的时间复杂度O(logn)，访问O(logn/K)个页
+        删除一个定时器的时间复杂度O(1)
+        执行一个定时器的时间复杂度O(logn)，访问O(logn/K)个页
+*/
+
+#ifndef B_HEAP_TIMER_HPP
+#define B_HEAP_TIMER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <exception>
+#include "time_heap_timer.hpp"
+#include "timer_clock.hpp"
+#include "timer_group.hpp"
+#include "timer_stats.hpp"
+#include "timer_traits.hpp"
+
+// 分页时间堆
+template <typename T>
+class b_heap : public lazy_heap_base<b_heap<T>, T>
+{
+    typedef lazy_heap_base<b_heap, T> base;
+    friend class lazy_heap_base<b_heap, T>;
+    using base::cur_size;
+public:
+    typedef heap_timer<T> timer_type;
+
+    // cap是初始容量，会被向上取整为一棵满二叉树的节点数
+    explicit b_heap(int cap = 255) : buf(nullptr), array(nullptr), levels(0)
+    {
+        int n = 1;
+        while((1 << n) - 1 < cap && n < 31)
+        {
+            ++n;
+        }
+        reallocate(n);
+    }
+
+    // 销毁分页时间堆
+    ~b_heap()
+    {
+        this->destroy_timers();
+        delete []buf;
+    }
+
+    // 添加目标定时器
+    void add_timer(timer_type* timer)
+    {
+        this->push_timer(timer);
+    }
+
+    // 把逻辑下标i换算成数组中的物理下标
+    size_t phys(size_t i) const
+    {
+        return layout.phys(i);
+    }
+
+private:
+    static const int K = 8;                 // 每页容纳的层数
+    static const int PAGE_SLOTS = 256;      // 每页的元素个数，16字节的元素恰好占满4KB
+
+    // 一棵levels层的树的分段方式：最上面一段有top层，其余每段K层。第0段只有一页，
+    // 第b段（b>=1）的子树根位于第top+(b-1)*K层，每个根占一页
+    struct page_layout
+    {
+        int top;                // 最上面一段的层数
+        size_t first_page[5];   // 每一段的第一页，int下标的树不超过31层，最多5段
+
+        void init(int levels)
+        {
+            top = levels % K ? levels % K : K;
+            first_page[0] = 0;
+            first_page[1] = 1;
+            for(int b = 1; b < 4; ++b)
+            {
+                int root_depth = top + (b - 1) * K;
+                first_page[b + 1] = first_page[b] + (root_depth < 63 ? static_cast<size_t>(1) << root_depth : 0);
+            }
+        }
+
+        size_t phys(size_t i) const
+        {
+            size_t m = i + 1;                               // 从1开始编号，第d层是[2^d, 2^(d+1))
+            int depth = 63 - __builtin_clzll(m);
+            if(depth < top)
+            {
+                return i;
+            }
+            int band = 1 + (depth - top) / K;               // 所在的段
+            int local_depth = (depth - top) % K;            // 在本段子树中的深度
+            size_t root = m >> local_depth;                 // 本段子树的根（从1开始编号）
+            size_t local = (m - (root << local_depth)) + (static_cast<size_t>(1) << local_depth) - 1;
+            size_t page = first_page[band] + (root - (static_cast<size_t>(1) << (depth - local_depth)));
+            return page * PAGE_SLOTS + local;
+        }
+    };
+
+    // 堆数组的元素，与时间堆相同：key的高32位是超时时间，低32位是入堆序号
+    struct entry
+    {
+        uint64_t key;
+        timer_type* timer;
+    };
+
+    entry& at(int i)
+    {
+        return array[layout.phys(i)];
+    }
+
+    timer_type* timer_at(int i) const
+    {
+        return array[layout.phys(i)].timer;
+    }
+
+    // 数组只能按整层扩大，每次多容纳一层
+    void reserve(int n)
+    {
+        while(static_cast<size_t>(n) > (static_cast<size_t>(1) << levels) - 1)
+        {
+            reallocate(levels + 1);
+        }
+    }
+
+    void push(int hole, uint64_t key, timer_type* timer)
+    {
+        entry e;
+        e.key = key;
+        e.timer = timer;
+        percolate_up(hole, e);
+    }
+
+    void rekey_top(uint64_t key)
+    {
+        array[0].key = key;
+        percolate_down(0);
+    }
+
+    // 用最后一个元素填补堆顶的空位并下虑
+    void fill_top(int last)
+    {
+        array[0] = at(last);
+        if(cur_size > 0)
+        {
+            percolate_down(0);
+        }
+    }
+
+    void move_entry(int from, int to)
+    {
+        at(to) = at(from);
+    }
+
+    void heapify()
+    {
+        for(int i = (cur_size-1)/2; i >= 0; --i)
+        {
+            percolate_down(i);
+        }
+    }
+
+    // 上虑和下虑沿着树逐层移动时，物理下标p可以由上一层的p直接推出：页内第l个元素的孩子是页内第2l+1、
+    // 2l+2个元素，即p+l+1和p+l+2。只有跨越段的边界时才需要用phys()重新计算，一次下虑只有几次
+
+    // depth层是否是所在段的第一层，即该层的节点都是页的根
+    bool page_root(int depth) const
+    {
+        return depth >= layout.top && ((depth - layout.top) & (K - 1)) == 0;
+    }
+
+    void percolate_up(int hole, entry e)
+    {
+        size_t p = layout.phys(hole);
+        int depth = 63 - __builtin_clzll(static_cast<size_t>(hole) + 1);
+        while(hole > 0)
+        {
+            int parent = (hole-1)/2;
+            size_t l = p & (PAGE_SLOTS - 1);
+            size_t pp = page_root(depth) ? layout.phys(parent) : p - l + (l-1)/2;
+            if(array[pp].key < e.key)
+            {
+                break;
+            }
+            array[p] = array[pp];
+            hole = parent;
+            p = pp;
+            --depth;
+        }
+        array[p] = e;
+    }
+
+    void percolate_down(int hole)
+    {
+        size_t p = layout.phys(hole);
+        int depth = 63 - __builtin_clzll(static_cast<size_t>(hole) + 1);
+        entry temp = array[p];
+        while(hole*2+1 <= cur_size - 1)
+        {
+            int child = hole*2+1;
+            // 两个孩子在同一页中相邻存放；hole位于段的最后一层时，它们分别是相邻两页的根
+            size_t c = 0;
+            size_t step = 1;
+            if(page_root(depth + 1))
+            {
+                c = layout.phys(child);
+                step = PAGE_SLOTS;
+            }
+            else
+            {
+                size_t l = p & (PAGE_SLOTS - 1);
+                c = p + l + 1;
+                // 往下第三层仍在本页中时预取它们，与时间堆的做法相同：8个元素跨三条缓存行，逐行预取
+                if(!page_root(depth + 2) && !page_root(depth + 3))
+                {
+                    timer_prefetch(&array[p + 7*l + 7], &array[p + 7*l + 14]);
+                }
+            }
+            if(child < cur_size - 1 && array[c + step].key < array[c].key)
+            {
+                ++child;
+                c += step;
+            }
+            if(array[c].key < temp.key)
+            {
+                array[p] = array[c];
+            }
+            else
+            {
+                break;
+            }
+            hole = child;
+            p = c;
+            ++depth;
+        }
+        array[p] = temp;
+    }
+
+    // 把数组调整为能容纳一棵new_levels层的满二叉树，并按新的分段重新排列已有的元素。
+    // 数组按4KB对齐，使每棵子树恰好落在一个页内
+    void reallocate(int new_levels)
+    {
+        page_layout new_layout;
+        new_layout.init(new_levels);
+        // 按整页分配，页内的预取不会越过数组的末尾
+        size_t slots = (new_layout.phys((static_cast<size_t>(1) << new_levels) - 2) / PAGE_SLOTS + 1) * PAGE_SLOTS;
+        entry* new_buf = new entry[slots + PAGE_SLOTS];
+        uintptr_t addr = reinterpret_cast<uintptr_t>(new_buf);
+        entry* new_array = reinterpret_cast<entry*>((addr + 4095) & ~static_cast<uintptr_t>(4095));
+        for(int i = 0; i < cur_size; ++i)
+        {
+            new_array[new_layout.phys(i)] = array[layout.phys(i)];
+        }
+        delete []buf;
+        buf = new_buf;
+        array = new_array;
+        layout = new_layout;
+        levels = new_levels;
+    }
+
+private:
+    entry* buf;             // 实际分配的内存
+    entry* array;           // 按页对齐的堆数组
+    page_layout layout;     // 当前的分段方式
+    int levels;             // 数组能容纳的满二叉树的层数
+};
+
+// 分页时间堆的统一适配接口
+template <typename T>
+struct timer_traits<b_heap<T> >
+{
+    typedef heap_timer<T> timer_type;
+
+    static timer_type* add_timer(b_heap<T>& heap, int timeout, void (*cb)(T), T data)
+    {
+        timer_type* timer = new timer_type(timeout);
+        timer->cb_func = cb;
+        timer->user_data = data;
+        heap.add_timer(timer);
+        return timer;
+    }
+
+    static void del_timer(b_heap<T>& heap, timer_type* timer)
+    {
+        heap.del_timer(timer);
+    }
+};
+
+#endif
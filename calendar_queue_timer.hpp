@@ -0,0 +1,382 @@
+/*
+    日历队列定时器（calendar queue）：把时间轴按宽度width切成“天”，nbuckets天构成一“年”，超时时间为
+    expire的定时器放入第(expire/width)%nbuckets个桶中，桶内是按超时时间升序排列的双向链表。取最小值时从
+    当前的天开始逐个桶检查，只有桶头的超时时间落在这一天之内才是最小值，否则前进到下一天；一年中都没有
+    找到时才退化为比较所有桶头。
+
+    它与时间轮的思路相同，但桶宽不是固定的：定时器数目超过桶数的两倍或少于桶数的一半时，桶数翻倍或减半，
+    同时根据最早到期的若干个定时器之间的平均间隔重新计算桶宽，使每个桶中平均只有少量定时器。这样10毫秒级
+    的请求超时和数小时的租约定时器混在一起时，既不需要时间轮那样多的转数，也不会像时间堆那样随着长期
+    定时器的数目增加而变慢。
+
+    超时时间的单位由调用者决定，tick(cur)传入同一单位的当前时间；不带参数的tick()以timer_now()为当前时间。
+
+    从执行效率来看：
+        添加一个定时器的平均时间复杂度O(1)
+        删除一个定时器的时间复杂度O(1)
+        执行一个定时器的平均时间复杂度O(1)
+        桶数调整的代价为O(n)，分摊到引起调整的插入和删除上仍为O(1)
+*/
+
+#ifndef CALENDAR_QUEUE_TIMER_HPP
+#define CALENDAR_QUEUE_TIMER_HPP
+
+#include <time.h>
+#include <algorithm>
+#include <vector>
+#include "timer_clock.hpp"
+#include "timer_pool.hpp"
+#include "timer_stats.hpp"
+#include "timer_traits.hpp"
+
+// 定时器类
+template <typename T>
+class calendar_timer
+{
+public:
+    calendar_timer() : period(0), bucket(-1), prev(nullptr), next(nullptr) {}
+
+    // 节点从线程本地的内存池中分配
+    static void* operator new(size_t size) { return timer_pool::allocate(size); }
+    static void operator delete(void* p, size_t size) { timer_pool::release(p, size); }
+public:
+    time_t expire;                  // 定时器生效的绝对时间
+    time_t period;                  // 周期定时器的重复间隔，为0表示一次性定时器
+    void (*cb_func)(T);             // 定时器回调函数
+    T user_data;                    // 用户数据
+    int bucket;                     // 定时器所在的桶
+    calendar_timer* prev;           // 桶内的前一个定时器
+    calendar_timer* next;           // 桶内的后一个定时器
+};
+
+// 日历队列定时器
+template <typename T>
+class calendar_queue
+{
+public:
+    typedef calendar_timer<T> timer_type;
+
+    // width是初始的桶宽，之后会根据实际的超时时间分布自动调整
+    explicit calendar_queue(time_t width = 1)
+        : buckets(static_cast<size_t>(MIN_BUCKETS), nullptr), bucket_width(width > 0 ? width : 1), count(0),
+          cur_bucket(0), bucket_top(bucket_width) {}
+
+    // 销毁日历队列中所有的定时器
+    ~calendar_queue()
+    {
+        for(size_t i = 0; i < buckets.size(); ++i)
+        {
+            timer_type* tmp = buckets[i];
+            while(tmp)
+            {
+                buckets[i] = tmp->next;
+                delete tmp;
+                tmp = buckets[i];
+            }
+        }
+    }
+
+    // 添加目标定时器
+    void add_timer(timer_type* timer)
+    {
+        if(!timer)
+        {
+            return;
+        }
+        stats.on_add();
+        insert(timer);
+        ++count;
+        if(count > 2 * static_cast<int>(buckets.size()))
+        {
+            resize(2 * buckets.size());
+        }
+    }
+
+    // 删除目标定时器
+    void del_timer(timer_type* timer)
+    {
+        // 回调函数为空的定时器正在执行它的一次性任务，已经离开桶，由tick负责销毁
+        if(!timer || !timer->cb_func)
+        {
+            return;
+        }
+        stats.on_cancel();
+        unlink(timer);
+        --count;
+        delete timer;
+        shrink();
+    }
+
+    // 调用者修改了timer->expire之后调用该函数调整定时器所在的桶
+    void adjust_timer(timer_type* timer)
+    {
+        if(!timer)
+        {
+            return;
+        }
+        unlink(timer);
+        insert(timer);
+    }
+
+    int size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return 0 == count;
+    }
+
+    // 当前的桶数和桶宽
+    int bucket_count() const
+    {
+        return static_cast<int>(buckets.size());
+    }
+
+    time_t width() const
+    {
+        return bucket_width;
+    }
+
+    // 获得最早到期的定时器
+    timer_type* top()
+    {
+        return find_min();
+    }
+
+    // 以timer_now()为当前时间的心搏函数
+    void tick()
+    {
+        tick(timer_now());
+    }
+
+    // 心搏函数，处理所有超时时间不晚于cur的定时器
+    void tick(time_t cur)
+    {
+        timer_stats::tick_scope scope(stats);
+        timer_type* tmp = nullptr;
+        while((tmp = find_min()) && tmp->expire <= cur)
+        {
+            // 先把定时器从桶中摘下，再执行其中的任务，回调函数可以安全地添加或删除其他定时器
+            unlink(tmp);
+            // 周期定时器以新的超时时间重新放入对应的桶
+            if(tmp->period > 0)
+            {
+                tmp->expire = timer_next_expire(tmp->expire, tmp->period, cur);
+                insert(tmp);
+                stats.on_fire(true);
+                tmp->cb_func(tmp->user_data);
+                continue;
+            }
+            --count;
+            // 先清空回调函数再执行，回调函数中对它自己调用del_timer就成了空操作
+            void (*cb)(T) = tmp->cb_func;
+            tmp->cb_func = nullptr;
+            stats.on_fire(false);
+            cb(tmp->user_data);
+            delete tmp;
+            shrink();
+        }
+    }
+
+    // 运行统计的快照
+    timer_stats_snapshot get_stats() const
+    {
+        return stats.snapshot();
+    }
+
+private:
+    static const size_t MIN_BUCKETS = 2;    // 最少的桶数
+    static const size_t SAMPLE = 25;        // 估算桶宽时采样的定时器数目
+
+    size_t bucket_of(time_t expire) const
+    {
+        return static_cast<size_t>(expire / bucket_width) & (buckets.size() - 1);
+    }
+
+    // 把定时器按超时时间插入所在桶的链表中，超时时间相同的定时器按加入的先后排列
+    void insert(timer_type* timer)
+    {
+        size_t b = bucket_of(timer->expire);
+        timer->bucket = static_cast<int>(b);
+        timer_type* prev = nullptr;
+        timer_type* tmp = buckets[b];
+        while(tmp && tmp->expire <= timer->expire)
+        {
+            prev = tmp;
+            tmp = tmp->next;
+        }
+        timer->prev = prev;
+        timer->next = tmp;
+        if(prev)
+        {
+            prev->next = timer;
+        }
+        else
+        {
+            buckets[b] = timer;
+        }
+        if(tmp)
+        {
+            tmp->prev = timer;
+        }
+        // 新定时器早于当前扫描到的那一天时，把扫描位置退回到它所在的那一天
+        if(timer->expire < bucket_top - bucket_width)
+        {
+            cur_bucket = b;
+            bucket_top = (timer->expire / bucket_width + 1) * bucket_width;
+        }
+    }
+
+    void unlink(timer_type* timer)
+    {
+        if(timer->prev)
+        {
+            timer->prev->next = timer->next;
+        }
+        else
+        {
+            buckets[timer->bucket] = timer->next;
+        }
+        if(timer->next)
+        {
+            timer->next->prev = timer->prev;
+        }
+        timer->prev = timer->next = nullptr;
+    }
+
+    // 从当前的天开始寻找最早到期的定时器，并把扫描位置停在它所在的那一天
+    timer_type* find_min()
+    {
+        if(0 == count)
+        {
+            return nullptr;
+        }
+        size_t n = buckets.size();
+        size_t b = cur_bucket;
+        time_t top = bucket_top;
+        for(size_t i = 0; i < n; ++i)
+        {
+            timer_type* head = buckets[b];
+            if(head && head->expire < top)
+            {
+                cur_bucket = b;
+                bucket_top = top;
+                return head;
+            }
+            b = (b + 1) & (n - 1);
+            top += bucket_width;
+        }
+        // 一整年都没有找到，说明最早的定时器在更远的年份，直接比较所有桶头
+        timer_type* min = nullptr;
+        for(size_t i = 0; i < n; ++i)
+        {
+            if(buckets[i] && (!min || buckets[i]->expire < min->expire))
+            {
+                min = buckets[i];
+            }
+        }
+        cur_bucket = min->bucket;
+        bucket_top = (min->expire / bucket_width + 1) * bucket_width;
+        return min;
+    }
+
+    void shrink()
+    {
+        if(buckets.size() > MIN_BUCKETS && count < static_cast<int>(buckets.size()) / 2)
+        {
+            resize(buckets.size() / 2);
+        }
+    }
+
+    // 按最早到期的SAMPLE个定时器之间的平均间隔估算新的桶宽，忽略大于平均间隔两倍的离群间隔，
+    // 桶宽取平均间隔的3倍
+    time_t estimate_width(std::vector<timer_type*>& timers) const
+    {
+        size_t n = timers.size() < SAMPLE ? timers.size() : SAMPLE;
+        if(n < 2)
+        {
+            return bucket_width;
+        }
+        std::partial_sort(timers.begin(), timers.begin() + n, timers.end(), expire_less);
+        time_t total = timers[n - 1]->expire - timers[0]->expire;
+        double avg = static_cast<double>(total) / (n - 1);
+        double sum = 0;
+        size_t used = 0;
+        for(size_t i = 1; i < n; ++i)
+        {
+            time_t gap = timers[i]->expire - timers[i - 1]->expire;
+            if(gap <= 2 * avg)
+            {
+                sum += gap;
+                ++used;
+            }
+        }
+        time_t width = used ? static_cast<time_t>(3 * sum / used) : 0;
+        return width > 0 ? width : 1;
+    }
+
+    static bool expire_less(const timer_type* a, const timer_type* b)
+    {
+        return a->expire < b->expire;
+    }
+
+    // 把桶数调整为new_size（2的幂），重新估算桶宽并重新分配所有定时器
+    void resize(size_t new_size)
+    {
+        std::vector<timer_type*> timers;
+        timers.reserve(count);
+        for(size_t i = 0; i < buckets.size(); ++i)
+        {
+            for(timer_type* tmp = buckets[i]; tmp; tmp = tmp->next)
+            {
+                timers.push_back(tmp);
+            }
+        }
+        bucket_width = estimate_width(timers);
+        buckets.assign(new_size, nullptr);
+        // 估算桶宽时已经把最早到期的定时器排到了最前面，把扫描位置放在它所在的那一天，再逐个插入
+        if(!timers.empty())
+        {
+            cur_bucket = bucket_of(timers[0]->expire);
+            bucket_top = (timers[0]->expire / bucket_width + 1) * bucket_width;
+        }
+        for(size_t i = 0; i < timers.size(); ++i)
+        {
+            insert(timers[i]);
+        }
+    }
+
+private:
+    std::vector<timer_type*> buckets;   // 日历的桶，每个桶是一条升序链表
+    time_t bucket_width;                // 桶宽，即一天的长度
+    int count;                          // 队列中定时器的数目
+    size_t cur_bucket;                  // 当前扫描到的桶
+    time_t bucket_top;                  // 当前扫描到的那一天的结束时间
+    timer_stats stats;                  // 运行统计
+};
+
+// 日历队列定时器的统一适配接口，超时时间以秒为单位
+template <typename T>
+struct timer_traits<calendar_queue<T> >
+{
+    typedef calendar_timer<T> timer_type;
+
+    static timer_type* add_timer(calendar_queue<T>& queue, int timeout, void (*cb)(T), T data)
+    {
+        timer_type* timer = new timer_type;
+        timer->expire = timer_now() + timeout;
+        timer->cb_func = cb;
+        timer->user_data = data;
+        queue.add_timer(timer);
+        return timer;
+    }
+
+    static void del_timer(calendar_queue<T>& queue, timer_type* timer)
+    {
+        queue.del_timer(timer);
+    }
+};
+
+#endif
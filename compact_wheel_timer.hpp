@@ -0,0 +1,189 @@
+/*
+    紧凑时间轮：时间轮的tw_timer节点包含两个int、回调函数指针、用户数据以及prev、next指针，再加上内存池
+    的对齐，每个定时器要占用48字节以上。一千万个连接各挂一个空闲超时定时器时，光节点就超过500MB。
+
+    紧凑时间轮的每个节点只有16字节：前后节点的32位下标、32位的到期滴答数和32位的回调函数编号。
+    节点不单独分配，而是存放在一个以定时器编号为下标的连续数组中。定时器编号由调用者指定，通常直接
+    使用连接的文件描述符，回调函数收到的也是这个编号，由调用者据此找到自己的连接数据，节点中不再保存
+    用户数据。回调函数事先通过register_callback登记到回调函数表中，节点只记录它在表中的编号。
+    这样一千万个定时器大约占用160MB。
+
+    与时间轮不同，节点中记录的是绝对的到期滴答数而不是剩余圈数，tick只需要把它与当前滴答数比较，
+    不必修改还要转圈的节点。滴答数按32位无符号数回绕，比较时取差值的符号，只要超时值小于2^31个滴答即可。
+
+    从执行效率来看：
+        添加一个定时器的时间复杂度O(1)
+        删除一个定时器的时间复杂度O(1)
+        执行一个定时器的时间复杂度与时间轮相同
+*/
+
+#ifndef COMPACT_WHEEL_TIMER_HPP
+#define COMPACT_WHEEL_TIMER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "timer_stats.hpp"
+
+// 紧凑时间轮
+class compact_wheel
+{
+public:
+    typedef void (*callback)(uint32_t id);      // 回调函数，参数是定时器编号
+
+    static const uint32_t NIL = 0xffffffffu;    // 空下标，同时表示未登记的回调函数
+
+    // slots是时间轮的槽数，每个槽对应一个滴答
+    explicit compact_wheel(int slots = 60)
+        : heads(slots > 0 ? slots : 1, static_cast<uint32_t>(NIL)), cur_tick(0), cursor(NIL), count(0) {}
+
+    // 登记回调函数，返回它在回调函数表中的编号
+    uint32_t register_callback(callback cb)
+    {
+        callbacks.push_back(cb);
+        return static_cast<uint32_t>(callbacks.size() - 1);
+    }
+
+    // 为编号为id的定时器安排timeout个滴答之后以cb_id号回调函数到期。定时器已经在时间轮上时重新安排它。
+    // cb_id不是register_callback返回的编号，或者id为NIL时不添加，返回false
+    bool add_timer(uint32_t id, int timeout, uint32_t cb_id)
+    {
+        if(cb_id >= callbacks.size() || id == NIL)
+        {
+            return false;
+        }
+        if(id >= nodes.size())
+        {
+            node n = { NIL, NIL, 0, NIL };
+            nodes.resize(static_cast<size_t>(id) + 1, n);
+        }
+        if(pending(id))
+        {
+            del_timer(id);
+        }
+        uint32_t ticks = timeout < 1 ? 1 : static_cast<uint32_t>(timeout);
+        node& n = nodes[id];
+        n.deadline = cur_tick + ticks;
+        n.cb_id = cb_id;
+        link(id);
+        ++count;
+        stats.on_add();
+        return true;
+    }
+
+    // 删除编号为id的定时器，它不在时间轮上时什么也不做
+    void del_timer(uint32_t id)
+    {
+        if(!pending(id))
+        {
+            return;
+        }
+        // 如果tick正准备访问的下一个定时器被回调函数删除，则让tick跳过它
+        if(id == cursor)
+        {
+            cursor = nodes[id].next;
+        }
+        unlink(id);
+        nodes[id].cb_id = NIL;
+        --count;
+        stats.on_cancel();
+    }
+
+    // 编号为id的定时器是否在时间轮上
+    bool pending(uint32_t id) const
+    {
+        return id < nodes.size() && nodes[id].cb_id != NIL;
+    }
+
+    int size() const
+    {
+        return count;
+    }
+
+    // 运行统计的快照
+    timer_stats_snapshot get_stats() const
+    {
+        return stats.snapshot();
+    }
+
+    // 心搏函数，处理当前槽中到期的定时器，然后转动到下一个槽
+    void tick()
+    {
+        timer_stats::tick_scope scope(stats);
+        uint32_t id = heads[cur_tick % heads.size()];
+        uint64_t visited = 0;       // 访问过的定时器数目，即当前槽的链表长度
+        while(id != NIL)
+        {
+            ++visited;
+            // 先记下下一个待访问的定时器，回调函数中删除它时del_timer会把cursor向后移动
+            cursor = nodes[id].next;
+            node& n = nodes[id];
+            if(static_cast<int32_t>(n.deadline - cur_tick) <= 0)
+            {
+                // 先把定时器从时间轮上摘下，再执行其中的任务，回调函数可以用同一个编号重新添加定时器
+                uint32_t cb_id = n.cb_id;
+                unlink(id);
+                n.cb_id = NIL;
+                --count;
+                stats.on_fire(false);
+                callbacks[cb_id](id);
+            }
+            id = cursor;
+        }
+        cursor = NIL;
+        stats.on_slot(visited);
+        ++cur_tick;
+    }
+
+private:
+    // 16字节的定时器节点
+    struct node
+    {
+        uint32_t next;      // 槽链表中的后一个节点
+        uint32_t prev;      // 槽链表中的前一个节点
+        uint32_t deadline;  // 到期的滴答数
+        uint32_t cb_id;     // 回调函数编号，为NIL表示定时器不在时间轮上
+    };
+
+    void link(uint32_t id)
+    {
+        node& n = nodes[id];
+        uint32_t& head = heads[n.deadline % heads.size()];
+        n.prev = NIL;
+        n.next = head;
+        if(head != NIL)
+        {
+            nodes[head].prev = id;
+        }
+        head = id;
+    }
+
+    void unlink(uint32_t id)
+    {
+        node& n = nodes[id];
+        if(n.prev != NIL)
+        {
+            nodes[n.prev].next = n.next;
+        }
+        else
+        {
+            heads[n.deadline % heads.size()] = n.next;
+        }
+        if(n.next != NIL)
+        {
+            nodes[n.next].prev = n.prev;
+        }
+        n.next = n.prev = NIL;
+    }
+
+private:
+    std::vector<node> nodes;            // 以定时器编号为下标的节点数组
+    std::vector<uint32_t> heads;        // 时间轮的槽，每个元素是槽链表头节点的编号
+    std::vector<callback> callbacks;    // 回调函数表
+    uint32_t cur_tick;                  // 当前滴答数
+    uint32_t cursor;                    // tick遍历当前槽时下一个要访问的定时器
+    int count;                          // 时间轮上的定时器数目
+    timer_stats stats;                  // 运行统计
+};
+
+#endif
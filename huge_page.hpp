@@ -0,0 +1,122 @@
+/*
+    大页内存：堆中有上千万个定时器时，堆数组和节点slab跨越数十万个4KB的页，TLB放不下这么多页表项，
+    下虑和访问节点时频繁发生TLB未命中。这里用mmap直接向内核申请内存，优先使用2MB的显式大页
+    （MAP_HUGETLB，需要管理员预留大页），预留不足时退回普通的匿名映射并用madvise(MADV_HUGEPAGE)
+    请求透明大页。扩容时用mremap把原有的物理页整体搬到新的虚拟地址，不需要逐个元素复制。
+
+    所有的申请都被向上取整到2MB的整数倍，所以只适合大块内存。非Linux系统上退回malloc/realloc。
+
+    定义宏TIMER_HUGE_PAGES后，time_heap的堆数组（达到2MB时）和timer_pool的slab改由这里分配。
+*/
+
+#ifndef HUGE_PAGE_HPP
+#define HUGE_PAGE_HPP
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+class huge_page
+{
+public:
+    static const size_t SIZE = 2 * 1024 * 1024;     // 大页的大小
+
+    // 把bytes向上取整到大页的整数倍
+    static size_t round(size_t bytes)
+    {
+        return (bytes + SIZE - 1) / SIZE * SIZE;
+    }
+
+    // 分配round(bytes)字节，失败时抛出std::bad_alloc
+    static void* allocate(size_t bytes)
+    {
+        bytes = round(bytes);
+#if defined(__linux__)
+        void* p = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+        p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if(p == MAP_FAILED)
+        {
+            // 没有预留的大页，退回普通映射并请求透明大页
+            p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(p == MAP_FAILED)
+            {
+                throw std::bad_alloc();
+            }
+            advise(p, bytes);
+        }
+        return p;
+#else
+        void* p = malloc(bytes);
+        if(!p)
+        {
+            throw std::bad_alloc();
+        }
+        return p;
+#endif
+    }
+
+    // 把由allocate分配的old_bytes字节调整为round(new_bytes)字节，内容保持不变，返回新地址
+    static void* reallocate(void* p, size_t old_bytes, size_t new_bytes)
+    {
+        old_bytes = round(old_bytes);
+        new_bytes = round(new_bytes);
+        if(old_bytes == new_bytes)
+        {
+            return p;
+        }
+#if defined(__linux__) && defined(MREMAP_MAYMOVE)
+        void* q = mremap(p, old_bytes, new_bytes, MREMAP_MAYMOVE);
+        if(q != MAP_FAILED)
+        {
+            advise(q, new_bytes);
+            return q;
+        }
+        // 较老的内核不支持对显式大页做mremap，此时只能复制
+        q = allocate(new_bytes);
+        memcpy(q, p, old_bytes < new_bytes ? old_bytes : new_bytes);
+        release(p, old_bytes);
+        return q;
+#else
+        void* q = realloc(p, new_bytes);
+        if(!q)
+        {
+            throw std::bad_alloc();
+        }
+        return q;
+#endif
+    }
+
+    // 释放由allocate或reallocate得到的内存，bytes与申请时一致
+    static void release(void* p, size_t bytes)
+    {
+        if(!p)
+        {
+            return;
+        }
+#if defined(__linux__)
+        munmap(p, round(bytes));
+#else
+        (void)bytes;
+        free(p);
+#endif
+    }
+
+private:
+    static void advise(void* p, size_t bytes)
+    {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        madvise(p, bytes, MADV_HUGEPAGE);
+#else
+        (void)p;
+        (void)bytes;
+#endif
+    }
+};
+
+#endif
@@ -12,84 +12,131 @@
 #define LST_TIMER
 
 #include <time.h>
-#define BUFFER_SIZE 64
-
-class util_timer;
-
-// 用户数据结构
-struct client_data
-{
-    sockaddr_in address;    // 客户端socket地址
-    int sockfd;             // socket文件描述符
-    char buf[BUFFER_SIZE];  // 读缓存
-    util_timer* timer;      // 定时器
-};
+#include <algorithm>
+#include "timer_clock.hpp"
+#include "timer_pool.hpp"
+#include "timer_group.hpp"
+#include "timer_log.hpp"
+#include "timer_stats.hpp"
+#include "timer_traits.hpp"
 
 // 定时器类
+// 模板参数T是定时器携带的用户数据类型，它按值存放在定时器节点中并原样传给回调函数。socket连接可以用
+// 指向自定义client_data的指针，重试、租约续期等非socket定时器则可以只携带一个整数，不必背着
+// sockaddr_in和读缓存
+template <typename T>
 class util_timer
 {
 public:
-    util_timer() : prev(nullptr), next(nullptr) {}
+    util_timer() : period(0), group(nullptr), prev(nullptr), next(nullptr), group_prev(nullptr), group_next(nullptr) {}
+
+    // 节点从线程本地的内存池中分配
+    static void* operator new(size_t size) { return timer_pool::allocate(size); }
+    static void operator delete(void* p, size_t size) { timer_pool::release(p, size); }
 public:
     time_t expire;                 // 任务的超时时间，这里用绝对时间
-    void (*cb_func)(client_data*); // 任务回调函数
-    client_data* user_data;        // 回调函数处理的客户数据，由定时器的执行者传递给回调函数
+    time_t period;                 // 周期定时器的重复间隔（秒），为0表示一次性定时器
+    void (*cb_func)(T);            // 任务回调函数
+    T user_data;                   // 回调函数处理的客户数据，由定时器的执行者传递给回调函数
+    timer_group<util_timer>* group; // 定时器所属的组
     util_timer* prev;              // 指向前一个定时器
     util_timer* next;              // 指向下一个定时器
+    util_timer* group_prev;        // 组链表中的前一个定时器
+    util_timer* group_next;        // 组链表中的后一个定时器
 };
 
 // 定时器链表：它是一个升序、双向链表，且带有头结点和尾节点
+template <typename T>
 class sort_timer_lst
 {
+public:
+    typedef util_timer<T> timer_type;
+
 public:
     sort_timer_lst() : head(nullptr), tail(nullptr) {}
     
     // 链表被销毁时，删除其中所有的定时器
     ~sort_timer_lst()
     {
-        util_timer* tmp = head;
+        timer_type* tmp = head;
         while(tmp)
         {
             head = tmp->next;
+            timer_group<timer_type>::leave(tmp);
             delete tmp;
             tmp = head;
         }
     }
 
     // 将目标定时器timer添加到链表中
-    void add_timer(util_timer* timer)
+    void add_timer(timer_type* timer)
     {
         if(!timer)
         {
             return;
         }
-        if(!head)
+        stats.on_add();
+        insert(timer);
+    }
+
+    // 批量添加定时器。逐个调用add_timer的代价是O(n*size)，这里先把新定时器按超时时间排序，再与原链表
+    // 做一次归并，总代价为O(n*log(n) + size)。超时时间相同的定时器，原链表中的排在前面，新定时器之间
+    // 保持它们在数组中的顺序，与逐个添加的结果一致
+    void add_timers(timer_type** timers, int n)
+    {
+        if(!timers || n <= 0)
         {
-            head = tail = timer;
             return;
         }
-        // 如果目标定时器的超时时间小于当前链表中的所有定时器的超时时间，则把该定时器插入链表头部，
-        // 作为链表新的头结点。否则就需要条用重载函数add_timer把它插入链表中合适的位置，以保证链表
-        // 的升序特性
-        if(timer->expire < head->expire)
+        std::stable_sort(timers, timers + n, expire_less);
+        timer_type* cur = head;
+        timer_type* prev = nullptr;
+        for(int i = 0; i < n; ++i)
         {
-            timer->next = head;
-            head->prev = timer;
-            head = timer;
-            return;
+            timer_type* timer = timers[i];
+            if(!timer)
+            {
+                continue;
+            }
+            stats.on_add();
+            // 跳过原链表中超时时间不大于新定时器的部分
+            while(cur && cur->expire <= timer->expire)
+            {
+                prev = cur;
+                cur = cur->next;
+            }
+            // 把新定时器插入prev和cur之间
+            timer->prev = prev;
+            timer->next = cur;
+            if(prev)
+            {
+                prev->next = timer;
+            }
+            else
+            {
+                head = timer;
+            }
+            if(cur)
+            {
+                cur->prev = timer;
+            }
+            else
+            {
+                tail = timer;
+            }
+            prev = timer;
         }
-        add_timer(timer, head);
     }
 
     // 当某个定时任务发生变化时，调整对应的定时器在链表中的位置。这个函数只考虑被调整的定时器的超时
     // 时间延长的情况，即该定时器需要往链表的尾部移动
-    void adjust_timer(util_timer* timer)
+    void adjust_timer(timer_type* timer)
     {
         if(!timer)
         {
             return;
         }
-        util_timer* tmp = timer->next;
+        timer_type* tmp = timer->next;
         // 如果被调整的定时器处于链表尾部，或者该定时器的超时值任然小于其他定时器超时值，则不调整
         if(!tmp || timer->expire < tmp->expire)
         {
@@ -113,12 +160,15 @@ public:
     }
 
     // 将目标定时器从链表中删除
-    void del_timer(util_timer* timer)
+    void del_timer(timer_type* timer)
     {
-        if(!timer)
+        // 回调函数为空的定时器正在执行它的一次性任务，已经离开链表，由tick负责销毁
+        if(!timer || !timer->cb_func)
         {
             return;
         }
+        stats.on_cancel();
+        timer_group<timer_type>::leave(timer);
         // 下面这个条件成立表示链表中只有一个定时器，即目标定时器
         if(timer == head && timer == tail)
         {
@@ -149,43 +199,109 @@ public:
         delete timer;
     }
 
+    // 删除组中的所有定时器。组链表直接给出了每个节点，每个节点都以O(1)的代价从升序链表中摘除
+    void del_group(timer_group<timer_type>& group)
+    {
+        while(!group.empty())
+        {
+            del_timer(group.front());
+        }
+    }
+
     // SIGALRM信号每次被触发就在其信号处理函数（如果使用统一事件源，则是主函数）中执行一次tick函数
     // ，以处理链表上的到期任务
     void tick()
     {
+        timer_stats::tick_scope scope(stats);
         if(!head)
         {
             return;
         }
-        printf("timer tick\n");
-        time_t cur = time(NULL);
-        util_timer* tmp = head;
+        TIMER_LOG("timer tick");
+        time_t cur = timer_now();
         // 从头结点开始一次处理每个定时器，知道遇到一个尚未到期的定时器，这个就是定时器的核心逻辑
-        while(tmp)
+        while(head)
         {
             // 因为每个定时器都使用绝对时间作为超时值，所以我们可以把定时器的超时值直接和系统时间比较
-            if(cur < tmp->expire)
+            if(cur < head->expire)
             {
                 break;
             }
-            // 调用定时器的回调函数，执行定时任务
-            tmp->cb_func(tmp->user_data);
-            // 执行完定时器的任务后，就将它从链表中删除，并重置链表头节点
+            // 先把到期的定时器从链表中摘下并重置链表头节点，再执行回调，这样回调函数（例如被唤醒的协程）
+            // 可以安全地向链表中添加或删除其他定时器
+            timer_type* tmp = head;
             head = tmp->next;
             if(head)
             {
                 head->prev = nullptr;
             }
+            else
+            {
+                tail = nullptr;
+            }
+            // 周期定时器以新的超时时间重新插入链表，节点原地复用
+            if(tmp->period > 0)
+            {
+                tmp->expire = timer_next_expire(tmp->expire, tmp->period, cur);
+                tmp->prev = tmp->next = nullptr;
+                insert(tmp);
+                stats.on_fire(true);
+                tmp->cb_func(tmp->user_data);
+                continue;
+            }
+            // 一次性定时器先离开所在的组，回调函数中取消整组定时器时就不会再碰到它
+            timer_group<timer_type>::leave(tmp);
+            // 先清空回调函数再执行定时任务，回调函数中对它自己调用del_timer就成了空操作
+            void (*cb)(T) = tmp->cb_func;
+            tmp->cb_func = nullptr;
+            stats.on_fire(false);
+            cb(tmp->user_data);
             delete tmp;
-            tmp = head;
         }
     }
+
+    // 运行统计的快照
+    timer_stats_snapshot get_stats() const
+    {
+        return stats.snapshot();
+    }
+
 private:
+    // 把定时器按超时时间插入链表
+    void insert(timer_type* timer)
+    {
+        if(!head)
+        {
+            head = tail = timer;
+            return;
+        }
+        // 如果目标定时器的超时时间小于当前链表中的所有定时器的超时时间，则把该定时器插入链表头部，
+        // 作为链表新的头结点。否则就需要条用重载函数add_timer把它插入链表中合适的位置，以保证链表
+        // 的升序特性
+        if(timer->expire < head->expire)
+        {
+            timer->next = head;
+            head->prev = timer;
+            head = timer;
+            return;
+        }
+        add_timer(timer, head);
+    }
+
+    static bool expire_less(const timer_type* a, const timer_type* b)
+    {
+        if(!a || !b)
+        {
+            return a && !b;
+        }
+        return a->expire < b->expire;
+    }
+
     // 该函数表示它将目标定时器timer添加到lst_head之后的部分链表中
-    void add_timer(util_timer* timer, util_timer* lst_head)
+    void add_timer(timer_type* timer, timer_type* lst_head)
     {
-        util_timer* prev = lst_head;
-        util_timer* tmp = prev->next;
+        timer_type* prev = lst_head;
+        timer_type* tmp = prev->next;
         // 遍历lst_head节点之后的部分链表，直到遇到超时时间大于目标定时器的超时时间
         while(tmp)
         {
@@ -211,8 +327,31 @@ private:
         }
     }
 private:
-    util_timer* head;   // 头节点
-    util_timer* tail;   // 尾节点
+    timer_type* head;   // 头节点
+    timer_type* tail;   // 尾节点
+    timer_stats stats;  // 运行统计
+};
+
+// 升序链表的统一适配接口
+template <typename T>
+struct timer_traits<sort_timer_lst<T> >
+{
+    typedef util_timer<T> timer_type;
+
+    static timer_type* add_timer(sort_timer_lst<T>& lst, int timeout, void (*cb)(T), T data)
+    {
+        timer_type* timer = new timer_type;
+        timer->expire = timer_now() + timeout;
+        timer->cb_func = cb;
+        timer->user_data = data;
+        lst.add_timer(timer);
+        return timer;
+    }
+
+    static void del_timer(sort_timer_lst<T>& lst, timer_type* timer)
+    {
+        lst.del_timer(timer);
+    }
 };
 
-#endif
\ No newline at end of file
+#endif
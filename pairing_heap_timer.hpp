@@ -0,0 +1,327 @@
+/*
+    配对堆定时器：用配对堆（pairing heap）代替二叉堆组织定时器。配对堆是一棵多叉树，每个节点用
+    child指向最左边的孩子，用next指向右边的兄弟，用prev指向左边的兄弟（最左边的孩子指向父节点）。
+    两个堆的合并（meld）只需要比较两个根节点并把较大的一个挂到较小的一个下面，所以插入和合并都是O(1)。
+
+    与时间堆相比，配对堆能够真正地调整和删除定时器：超时时间缩短时只需把该子树剪下并与根节点合并；
+    删除定时器或延长超时时间时，先把它的孩子们两两配对合并，再重新挂回堆中。工作线程被回收时，
+    可以用meld把它的全部定时器O(1)地并入另一个分片。
+
+    从执行效率来看：
+        添加一个定时器的时间复杂度O(1)
+        缩短超时时间（decrease-key）的时间复杂度O(1)
+        合并两个定时器堆的时间复杂度O(1)
+        删除定时器、延长超时时间、执行一个定时器的时间复杂度均摊O(logn)
+*/
+
+#ifndef PAIRING_HEAP_TIMER_HPP
+#define PAIRING_HEAP_TIMER_HPP
+
+#include <time.h>
+#include <vector>
+#include "timer_clock.hpp"
+#include "timer_pool.hpp"
+#include "timer_stats.hpp"
+#include "timer_traits.hpp"
+
+// 定时器类
+template <typename T>
+class pairing_timer
+{
+public:
+    pairing_timer() : key(0), period(0), child(nullptr), next(nullptr), prev(nullptr) {}
+
+    // 节点从线程本地的内存池中分配
+    static void* operator new(size_t size) { return timer_pool::allocate(size); }
+    static void operator delete(void* p, size_t size) { timer_pool::release(p, size); }
+public:
+    time_t expire;                  // 定时器生效的绝对时间
+    time_t key;                     // 定时器在堆中排序所用的超时时间，即最近一次入堆或调整时的expire
+    time_t period;                  // 周期定时器的重复间隔（秒），为0表示一次性定时器
+    void (*cb_func)(T);             // 定时器回调函数
+    T user_data;                    // 用户数据
+    pairing_timer* child;           // 最左边的孩子
+    pairing_timer* next;            // 右边的兄弟
+    pairing_timer* prev;            // 左边的兄弟，最左边的孩子指向父节点
+};
+
+// 配对堆定时器
+template <typename T>
+class pairing_heap
+{
+public:
+    typedef pairing_timer<T> timer_type;
+
+    pairing_heap() : root(nullptr), count(0) {}
+
+    // 销毁配对堆中所有的定时器
+    ~pairing_heap()
+    {
+        std::vector<timer_type*> stack;
+        if(root)
+        {
+            stack.push_back(root);
+        }
+        while(!stack.empty())
+        {
+            timer_type* tmp = stack.back();
+            stack.pop_back();
+            if(tmp->child)
+            {
+                stack.push_back(tmp->child);
+            }
+            if(tmp->next)
+            {
+                stack.push_back(tmp->next);
+            }
+            delete tmp;
+        }
+    }
+
+    // 添加目标定时器：把它当作只有一个节点的堆与根节点合并
+    void add_timer(timer_type* timer)
+    {
+        if(!timer)
+        {
+            return;
+        }
+        stats.on_add();
+        insert(timer);
+    }
+
+    // 调用者修改了timer->expire之后调用该函数调整定时器在堆中的位置。超时时间缩短时，把以它为根的子树
+    // 剪下并与根节点合并，代价为O(1)；超时时间延长时，先把它从堆中摘下再重新插入，代价为均摊O(logn)
+    void adjust_timer(timer_type* timer)
+    {
+        if(!timer)
+        {
+            return;
+        }
+        if(timer->expire < timer->key)
+        {
+            timer->key = timer->expire;
+            if(timer != root)
+            {
+                cut(timer);
+                root = link(root, timer);
+            }
+        }
+        else if(timer->expire > timer->key)
+        {
+            remove(timer);
+            --count;
+            insert(timer);
+        }
+    }
+
+    // 删除目标定时器
+    void del_timer(timer_type* timer)
+    {
+        // 回调函数为空的定时器正在执行它的一次性任务，已经离开堆，由tick负责销毁
+        if(!timer || !timer->cb_func)
+        {
+            return;
+        }
+        stats.on_cancel();
+        remove(timer);
+        --count;
+        delete timer;
+    }
+
+    // 把other中的全部定时器并入本堆，other随之变空
+    void meld(pairing_heap& other)
+    {
+        if(&other == this || !other.root)
+        {
+            return;
+        }
+        root = root ? link(root, other.root) : other.root;
+        stats.on_transfer(other.stats, other.count);
+        count += other.count;
+        other.root = nullptr;
+        other.count = 0;
+    }
+
+    // 获得堆顶部的定时器
+    timer_type* top() const
+    {
+        return root;
+    }
+
+    int size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return !root;
+    }
+
+    // 心搏函数，处理所有到期的定时器
+    void tick()
+    {
+        timer_stats::tick_scope scope(stats);
+        time_t cur = timer_now();
+        while(root && root->key <= cur)
+        {
+            // 先把堆顶定时器取出，再执行其中的任务，回调函数可以安全地添加或删除其他定时器
+            timer_type* tmp = root;
+            root = merge_pairs(tmp->child);
+            tmp->child = nullptr;
+            --count;
+            // 周期定时器以新的超时时间作为单节点堆重新合并进来
+            if(tmp->period > 0)
+            {
+                tmp->expire = timer_next_expire(tmp->expire, tmp->period, cur);
+                insert(tmp);
+                stats.on_fire(true);
+                tmp->cb_func(tmp->user_data);
+                continue;
+            }
+            // 先清空回调函数再执行，回调函数中对它自己调用del_timer就成了空操作
+            void (*cb)(T) = tmp->cb_func;
+            tmp->cb_func = nullptr;
+            stats.on_fire(false);
+            cb(tmp->user_data);
+            delete tmp;
+        }
+    }
+
+    // 运行统计的快照
+    timer_stats_snapshot get_stats() const
+    {
+        return stats.snapshot();
+    }
+
+private:
+    // 把定时器当作只有一个节点的堆与根节点合并
+    void insert(timer_type* timer)
+    {
+        timer->key = timer->expire;
+        timer->child = timer->next = timer->prev = nullptr;
+        root = root ? link(root, timer) : timer;
+        ++count;
+    }
+
+    // 合并两棵没有兄弟的树，超时时间较大的根成为另一个根最左边的孩子
+    static timer_type* link(timer_type* a, timer_type* b)
+    {
+        if(b->key < a->key)
+        {
+            timer_type* tmp = a;
+            a = b;
+            b = tmp;
+        }
+        b->prev = a;
+        b->next = a->child;
+        if(a->child)
+        {
+            a->child->prev = b;
+        }
+        a->child = b;
+        return a;
+    }
+
+    // 把以timer为根的子树从它的父节点和兄弟中剪下
+    static void cut(timer_type* timer)
+    {
+        if(timer->prev->child == timer)
+        {
+            timer->prev->child = timer->next;
+        }
+        else
+        {
+            timer->prev->next = timer->next;
+        }
+        if(timer->next)
+        {
+            timer->next->prev = timer->prev;
+        }
+        timer->next = timer->prev = nullptr;
+    }
+
+    // 经典的两趟合并：第一趟从左到右把兄弟两两合并，第二趟从右到左把结果依次合并成一棵树
+    static timer_type* merge_pairs(timer_type* first)
+    {
+        if(!first)
+        {
+            return nullptr;
+        }
+        timer_type* merged = nullptr;   // 第一趟的结果，用next串成一个栈
+        while(first)
+        {
+            timer_type* a = first;
+            timer_type* b = a->next;
+            first = b ? b->next : nullptr;
+            a->next = a->prev = nullptr;
+            if(b)
+            {
+                b->next = b->prev = nullptr;
+                a = link(a, b);
+            }
+            a->next = merged;
+            merged = a;
+        }
+        timer_type* result = merged;
+        merged = merged->next;
+        result->next = nullptr;
+        while(merged)
+        {
+            timer_type* tmp = merged;
+            merged = merged->next;
+            tmp->next = nullptr;
+            result = link(result, tmp);
+        }
+        result->prev = nullptr;
+        return result;
+    }
+
+    // 把timer从堆中摘下但不删除，它的孩子们两两合并后重新挂回堆中
+    void remove(timer_type* timer)
+    {
+        if(timer == root)
+        {
+            root = merge_pairs(timer->child);
+        }
+        else
+        {
+            cut(timer);
+            timer_type* sub = merge_pairs(timer->child);
+            if(sub)
+            {
+                root = link(root, sub);
+            }
+        }
+        timer->child = timer->next = timer->prev = nullptr;
+    }
+
+private:
+    timer_type* root;   // 堆顶定时器
+    int count;          // 堆中定时器的数目
+    timer_stats stats;  // 运行统计
+};
+
+// 配对堆定时器的统一适配接口
+template <typename T>
+struct timer_traits<pairing_heap<T> >
+{
+    typedef pairing_timer<T> timer_type;
+
+    static timer_type* add_timer(pairing_heap<T>& heap, int timeout, void (*cb)(T), T data)
+    {
+        timer_type* timer = new timer_type;
+        timer->expire = timer_now() + timeout;
+        timer->cb_func = cb;
+        timer->user_data = data;
+        heap.add_timer(timer);
+        return timer;
+    }
+
+    static void del_timer(pairing_heap<T>& heap, timer_type* timer)
+    {
+        heap.del_timer(timer);
+    }
+};
+
+#endif
@@ -0,0 +1,260 @@
+/*
+    基数堆定时器：定时器总是按照不早于“当前时间”的顺序被取出，这正是单调优先队列的场景。基数堆记录
+    最近一次取出的超时值last，把超时值key放入第bucket(key)个桶中，其中bucket(key)是key与last最高的
+    不同二进制位的位置加1（key等于last时为0）。取最小值时，如果0号桶为空，就找到第一个非空的桶，
+    以其中的最小值作为新的last，再把这个桶里的定时器重新分配到更低的桶中。每个定时器最多下移64次。
+
+    键是64位的滴答数，tick(now)由调用者传入当前滴答数；不带参数的tick()以timer_now()作为滴答数，
+    与其他引擎的秒级超时时间一致。桶是连续存放(key, 定时器指针)的数组，分配和比较时只顺序访问
+    数组中的键，不需要像时间堆那样沿指针逐层比较。
+
+    约束：加入的定时器超时值不能早于last，更早的超时值会被当作last，在下一次tick中立即到期。
+    删除定时器采用与时间堆相同的延迟销毁策略。
+
+    从执行效率来看：
+        添加一个定时器的时间复杂度O(1)
+        删除一个定时器的时间复杂度O(1)
+        执行一个定时器的时间复杂度均摊O(logC)，C为最大超时值与当前时间之差
+*/
+
+#ifndef RADIX_HEAP_TIMER_HPP
+#define RADIX_HEAP_TIMER_HPP
+
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+#include "timer_clock.hpp"
+#include "timer_pool.hpp"
+#include "timer_stats.hpp"
+#include "timer_traits.hpp"
+
+// 定时器类
+template <typename T>
+class radix_timer
+{
+public:
+    radix_timer() : period(0) {}
+
+    // 节点从线程本地的内存池中分配
+    static void* operator new(size_t size) { return timer_pool::allocate(size); }
+    static void operator delete(void* p, size_t size) { timer_pool::release(p, size); }
+public:
+    uint64_t expire;                // 定时器到期的滴答数
+    uint64_t period;                // 周期定时器的重复间隔（滴答数），为0表示一次性定时器
+    void (*cb_func)(T);             // 定时器回调函数
+    T user_data;                    // 用户数据
+};
+
+// 基数堆定时器
+template <typename T>
+class radix_heap
+{
+public:
+    typedef radix_timer<T> timer_type;
+
+    radix_heap() : last(0), count(0), dead_num(0) {}
+
+    // 销毁基数堆中所有的定时器
+    ~radix_heap()
+    {
+        for(int i = 0; i < BUCKETS; ++i)
+        {
+            for(size_t j = 0; j < buckets[i].size(); ++j)
+            {
+                delete buckets[i][j].timer;
+            }
+        }
+    }
+
+    // 添加目标定时器
+    void add_timer(timer_type* timer)
+    {
+        if(!timer)
+        {
+            return;
+        }
+        if(timer->expire < last)
+        {
+            timer->expire = last;
+        }
+        stats.on_add();
+        push(timer);
+        ++count;
+    }
+
+    // 删除目标定时器：与时间堆一样只把回调函数置空，定时器在到期时才真正被销毁
+    void del_timer(timer_type* timer)
+    {
+        if(!timer || !timer->cb_func)
+        {
+            return;
+        }
+        timer->cb_func = nullptr;
+        ++dead_num;
+        stats.on_cancel();
+        stats.set_tombstones(dead_num);
+    }
+
+    // 基数堆中的定时器个数，包括被延迟销毁的定时器
+    int size() const
+    {
+        return count;
+    }
+
+    // 仍然有效的定时器个数
+    int live_size() const
+    {
+        return count - dead_num;
+    }
+
+    bool empty() const
+    {
+        return 0 == count;
+    }
+
+    // 最近一次取出的定时器的滴答数，新定时器的超时值不能早于它
+    uint64_t now() const
+    {
+        return last;
+    }
+
+    // 以timer_now()作为当前滴答数的心搏函数
+    void tick()
+    {
+        tick(static_cast<uint64_t>(timer_now()));
+    }
+
+    // 心搏函数，处理所有滴答数不大于cur的定时器
+    void tick(uint64_t cur)
+    {
+        timer_stats::tick_scope scope(stats);
+        while(refill(cur))
+        {
+            // 先把定时器从0号桶中取出，再执行其中的任务，回调函数可以安全地添加定时器
+            timer_type* tmp = buckets[0].back().timer;
+            buckets[0].pop_back();
+            --count;
+            if(!tmp->cb_func)
+            {
+                --dead_num;
+                delete tmp;
+                continue;
+            }
+            // 周期定时器以新的滴答数重新放入对应的桶
+            if(tmp->period > 0)
+            {
+                tmp->expire = timer_next_expire(tmp->expire, tmp->period, cur);
+                push(tmp);
+                ++count;
+                stats.on_fire(true);
+                tmp->cb_func(tmp->user_data);
+                continue;
+            }
+            // 节点已经离开堆，先清空回调函数，回调函数中对它自己调用del_timer就成了空操作
+            void (*cb)(T) = tmp->cb_func;
+            tmp->cb_func = nullptr;
+            stats.on_fire(false);
+            cb(tmp->user_data);
+            delete tmp;
+        }
+        stats.set_tombstones(dead_num);
+    }
+
+    // 运行统计的快照，槽的长度是refill重新分配的桶的大小
+    timer_stats_snapshot get_stats() const
+    {
+        return stats.snapshot();
+    }
+
+private:
+    struct entry
+    {
+        uint64_t key;       // 定时器入堆时的超时值，分配桶时只读取它，不访问定时器本身
+        timer_type* timer;
+    };
+
+    static const int BUCKETS = 65;  // 0号桶存放等于last的键，第i号桶存放与last最高不同位为i-1的键
+
+    int bucket_index(uint64_t key) const
+    {
+        uint64_t diff = key ^ last;
+        return diff ? 64 - __builtin_clzll(diff) : 0;
+    }
+
+    void push(timer_type* timer)
+    {
+        entry e = { timer->expire, timer };
+        buckets[bucket_index(e.key)].push_back(e);
+    }
+
+    // 保证0号桶非空：找到第一个非空的桶，以其中的最小键作为新的last，并把桶中的定时器重新分配到更低的桶里。
+    // 最小键晚于cur时不做分配并返回false，这样last永远不会越过当前时间，之后加入的较近的定时器不会被推迟
+    bool refill(uint64_t cur)
+    {
+        if(!buckets[0].empty())
+        {
+            return last <= cur;
+        }
+        int i = 1;
+        while(i < BUCKETS && buckets[i].empty())
+        {
+            ++i;
+        }
+        if(i == BUCKETS)
+        {
+            return false;
+        }
+        std::vector<entry>& bucket = buckets[i];
+        uint64_t min_key = bucket[0].key;
+        for(size_t j = 1; j < bucket.size(); ++j)
+        {
+            if(bucket[j].key < min_key)
+            {
+                min_key = bucket[j].key;
+            }
+        }
+        if(min_key > cur)
+        {
+            return false;
+        }
+        last = min_key;
+        stats.on_slot(bucket.size());
+        for(size_t j = 0; j < bucket.size(); ++j)
+        {
+            buckets[bucket_index(bucket[j].key)].push_back(bucket[j]);
+        }
+        bucket.clear();
+        return true;
+    }
+
+private:
+    std::vector<entry> buckets[BUCKETS];    // 基数堆的桶
+    uint64_t last;                          // 最近一次取出的键
+    int count;                              // 堆中定时器的数目
+    int dead_num;                           // 被延迟销毁的定时器数目
+    timer_stats stats;                      // 运行统计
+};
+
+// 基数堆定时器的统一适配接口，超时值以秒为单位，使用timer_now()作为滴答数
+template <typename T>
+struct timer_traits<radix_heap<T> >
+{
+    typedef radix_timer<T> timer_type;
+
+    static timer_type* add_timer(radix_heap<T>& heap, int timeout, void (*cb)(T), T data)
+    {
+        timer_type* timer = new timer_type;
+        timer->expire = static_cast<uint64_t>(timer_now()) + timeout;
+        timer->cb_func = cb;
+        timer->user_data = data;
+        heap.add_timer(timer);
+        return timer;
+    }
+
+    static void del_timer(radix_heap<T>& heap, timer_type* timer)
+    {
+        heap.del_timer(timer);
+    }
+};
+
+#endif
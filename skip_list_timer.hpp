@@ -0,0 +1,398 @@
+/*
+    跳表定时器：接口与升序链表定时器sort_timer_lst相同（add_timer、add_timers、adjust_timer、del_timer、
+    del_group、tick），可以直接替换它。底层是按超时时间升序排列的跳表，第0层就是一条完整的升序链表，因此保留了链表定时器
+    按顺序遍历和从头部批量处理到期定时器的特点，而添加和调整定时器不再需要线性扫描。
+
+    每个定时器在创建时以1/4的概率逐层晋升，随机决定自己的层数；超时时间相同的定时器按加入的先后排序。
+
+    从执行效率来看：
+        添加定时器的时间复杂度是O(logn)，批量添加m个定时器不超过O(mlogm + mlogn)
+        调整定时器的时间复杂度是O(logn)，超时时间延长和缩短都支持
+        删除定时器的时间复杂度是O(logn)
+        执行定时器任务的时间复杂度是O(1)
+*/
+
+#ifndef SKIP_LIST_TIMER_HPP
+#define SKIP_LIST_TIMER_HPP
+
+#include <stdint.h>
+#include <time.h>
+#include <algorithm>
+#include "timer_clock.hpp"
+#include "timer_group.hpp"
+#include "timer_pool.hpp"
+#include "timer_stats.hpp"
+#include "timer_traits.hpp"
+
+// 定时器类
+template <typename T>
+class skip_timer
+{
+public:
+    static const int MAX_LEVEL = 16;    // 跳表的最大层数，以1/4的晋升概率足够容纳数十亿个定时器
+
+    skip_timer()
+        : key(0), period(0), level(random_level()), seq(0), group(nullptr), group_prev(nullptr), group_next(nullptr)
+    {
+        // 每层的后继指针数组按实际层数从内存池分配，大多数定时器只有1层
+        forward = static_cast<skip_timer**>(timer_pool::allocate(level * sizeof(skip_timer*)));
+        for(int i = 0; i < level; ++i)
+        {
+            forward[i] = nullptr;
+        }
+    }
+
+    ~skip_timer()
+    {
+        timer_pool::release(forward, level * sizeof(skip_timer*));
+    }
+
+    // 节点从线程本地的内存池中分配
+    static void* operator new(size_t size) { return timer_pool::allocate(size); }
+    static void operator delete(void* p, size_t size) { timer_pool::release(p, size); }
+public:
+    time_t expire;                  // 任务的超时时间，这里用绝对时间
+    time_t key;                     // 定时器在跳表中排序所用的超时时间，即最近一次加入跳表时的expire
+    time_t period;                  // 周期定时器的重复间隔（秒），为0表示一次性定时器
+    void (*cb_func)(T);             // 任务回调函数
+    T user_data;                    // 回调函数处理的客户数据
+    int level;                      // 定时器在跳表中的层数
+    uint64_t seq;                   // 加入跳表时的序号，用于区分超时时间相同的定时器
+    skip_timer** forward;           // forward[i]指向第i层的下一个定时器，forward[0]即升序链表中的下一个
+    timer_group<skip_timer>* group; // 定时器所属的组
+    skip_timer* group_prev;         // 组链表中的前一个定时器
+    skip_timer* group_next;         // 组链表中的后一个定时器
+
+private:
+    skip_timer(const skip_timer&);
+    skip_timer& operator=(const skip_timer&);
+
+    static int random_level()
+    {
+        static thread_local uint32_t state = 2463534242u;
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        int lvl = 1;
+        uint32_t bits = state;
+        // 每两位随机数决定一次是否晋升，晋升概率为1/4
+        while(lvl < MAX_LEVEL && (bits & 3) == 0)
+        {
+            ++lvl;
+            bits >>= 2;
+        }
+        return lvl;
+    }
+};
+
+// 跳表定时器
+template <typename T>
+class skip_timer_lst
+{
+public:
+    typedef skip_timer<T> timer_type;
+
+    skip_timer_lst() : level(1), count(0), next_seq(0)
+    {
+        for(int i = 0; i < timer_type::MAX_LEVEL; ++i)
+        {
+            head[i] = nullptr;
+        }
+    }
+
+    // 跳表被销毁时，沿第0层删除其中所有的定时器
+    ~skip_timer_lst()
+    {
+        timer_type* tmp = head[0];
+        while(tmp)
+        {
+            head[0] = tmp->forward[0];
+            timer_group<timer_type>::leave(tmp);
+            delete tmp;
+            tmp = head[0];
+        }
+    }
+
+    // 将目标定时器timer添加到跳表中
+    void add_timer(timer_type* timer)
+    {
+        if(!timer)
+        {
+            return;
+        }
+        stats.on_add();
+        insert(timer);
+    }
+
+    // 批量添加定时器。先把新定时器按超时时间排序，后一个新定时器在每一层的插入位置都不早于前一个，
+    // 查找时从前一个定时器在这一层的前驱出发，不必每次都从表头开始。超时时间相同的定时器，原跳表中的
+    // 排在前面，新定时器之间保持它们在数组中的顺序，与逐个添加的结果一致
+    void add_timers(timer_type** timers, int n)
+    {
+        if(!timers || n <= 0)
+        {
+            return;
+        }
+        std::stable_sort(timers, timers + n, expire_less);
+        // finger[i]是上一个新定时器在第i层的前驱，为空表示表头
+        timer_type* finger[timer_type::MAX_LEVEL];
+        for(int i = 0; i < timer_type::MAX_LEVEL; ++i)
+        {
+            finger[i] = nullptr;
+        }
+        for(int k = 0; k < n; ++k)
+        {
+            timer_type* timer = timers[k];
+            if(!timer)
+            {
+                continue;
+            }
+            stats.on_add();
+            timer->key = timer->expire;
+            timer->seq = next_seq++;
+            if(timer->level > level)
+            {
+                level = timer->level;
+            }
+            timer_type** update[timer_type::MAX_LEVEL];
+            timer_type* prev = nullptr;
+            for(int i = timer_type::MAX_LEVEL - 1; i >= 0; --i)
+            {
+                if(i < level)
+                {
+                    // 从上一层停下的位置和finger[i]中较靠后的一个出发
+                    if(finger[i] && (!prev || less(prev, finger[i])))
+                    {
+                        prev = finger[i];
+                    }
+                    timer_type** links = prev ? prev->forward : head;
+                    while(links[i] && less(links[i], timer))
+                    {
+                        prev = links[i];
+                        links = prev->forward;
+                    }
+                    finger[i] = prev;
+                    update[i] = &links[i];
+                }
+                else
+                {
+                    update[i] = &head[i];
+                }
+            }
+            link(timer, update);
+            for(int i = 0; i < timer->level; ++i)
+            {
+                finger[i] = timer;
+            }
+        }
+    }
+
+    // 当某个定时任务发生变化时，调整对应的定时器在跳表中的位置。调用者先修改timer->expire再调用本函数，
+    // 用法与sort_timer_lst相同；跳表按节点中记录的旧超时时间key定位节点，因此超时时间延长和缩短都只需
+    // O(logn)
+    void adjust_timer(timer_type* timer)
+    {
+        if(!timer)
+        {
+            return;
+        }
+        unlink(timer);
+        insert(timer);
+    }
+
+    // 将目标定时器从跳表中删除
+    void del_timer(timer_type* timer)
+    {
+        // 回调函数为空的定时器正在执行它的一次性任务，已经离开跳表，由tick负责销毁
+        if(!timer || !timer->cb_func)
+        {
+            return;
+        }
+        stats.on_cancel();
+        timer_group<timer_type>::leave(timer);
+        unlink(timer);
+        delete timer;
+    }
+
+    // 删除组中的所有定时器。组链表直接给出了每个节点，每个节点以O(logn)的代价从跳表中摘除
+    void del_group(timer_group<timer_type>& group)
+    {
+        while(!group.empty())
+        {
+            del_timer(group.front());
+        }
+    }
+
+    // 跳表中最早到期的定时器，沿forward[0]可以按到期顺序遍历所有定时器
+    timer_type* front() const
+    {
+        return head[0];
+    }
+
+    int size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return 0 == count;
+    }
+
+    // 心搏函数，处理跳表头部所有到期的定时器
+    void tick()
+    {
+        timer_stats::tick_scope scope(stats);
+        time_t cur = timer_now();
+        while(head[0])
+        {
+            timer_type* tmp = head[0];
+            if(cur < tmp->key)
+            {
+                break;
+            }
+            // 到期的定时器一定是它所在各层的第一个节点，直接把各层的头指针后移即可摘下，不需要查找
+            for(int i = 0; i < tmp->level; ++i)
+            {
+                head[i] = tmp->forward[i];
+            }
+            --count;
+            // 周期定时器以新的超时时间重新插入跳表，节点和层数原样复用
+            if(tmp->period > 0)
+            {
+                tmp->expire = timer_next_expire(tmp->expire, tmp->period, cur);
+                insert(tmp);
+                stats.on_fire(true);
+                tmp->cb_func(tmp->user_data);
+                continue;
+            }
+            // 一次性定时器先离开所在的组，回调函数中取消整组定时器时就不会再碰到它
+            timer_group<timer_type>::leave(tmp);
+            // 先清空回调函数再执行，回调函数中对它自己调用del_timer就成了空操作
+            void (*cb)(T) = tmp->cb_func;
+            tmp->cb_func = nullptr;
+            stats.on_fire(false);
+            cb(tmp->user_data);
+            delete tmp;
+        }
+    }
+
+    // 运行统计的快照
+    timer_stats_snapshot get_stats() const
+    {
+        return stats.snapshot();
+    }
+
+private:
+    // 按超时时间把timer插入跳表
+    void insert(timer_type* timer)
+    {
+        timer->key = timer->expire;
+        timer->seq = next_seq++;
+        timer_type** update[timer_type::MAX_LEVEL];
+        find(timer, update);
+        link(timer, update);
+    }
+
+    // 把timer接到update给出的各层位置上
+    void link(timer_type* timer, timer_type** update[])
+    {
+        if(timer->level > level)
+        {
+            level = timer->level;
+        }
+        for(int i = 0; i < timer->level; ++i)
+        {
+            timer->forward[i] = *update[i];
+            *update[i] = timer;
+        }
+        ++count;
+    }
+
+    static bool expire_less(const timer_type* a, const timer_type* b)
+    {
+        if(!a || !b)
+        {
+            return a && !b;
+        }
+        return a->expire < b->expire;
+    }
+
+    // 按(key, seq)的顺序比较两个定时器
+    static bool less(const timer_type* a, const timer_type* b)
+    {
+        return a->key < b->key || (a->key == b->key && a->seq < b->seq);
+    }
+
+    // 查找timer在每一层的插入位置，update[i]指向第i层中应当指向timer的那个后继指针
+    void find(const timer_type* timer, timer_type** update[])
+    {
+        timer_type** links = head;
+        for(int i = timer_type::MAX_LEVEL - 1; i >= 0; --i)
+        {
+            if(i < level)
+            {
+                while(links[i] && less(links[i], timer))
+                {
+                    links = links[i]->forward;
+                }
+            }
+            update[i] = &links[i];
+        }
+    }
+
+    // 把timer从跳表中摘下但不删除
+    void unlink(timer_type* timer)
+    {
+        timer_type** update[timer_type::MAX_LEVEL];
+        find(timer, update);
+        remove(timer, update);
+    }
+
+    void remove(timer_type* timer, timer_type** update[])
+    {
+        for(int i = 0; i < timer->level; ++i)
+        {
+            if(*update[i] == timer)
+            {
+                *update[i] = timer->forward[i];
+            }
+        }
+        while(level > 1 && !head[level - 1])
+        {
+            --level;
+        }
+        --count;
+    }
+
+private:
+    timer_type* head[skip_timer<T>::MAX_LEVEL];   // 每一层的头指针
+    int level;                                    // 当前跳表的层数
+    int count;                                    // 跳表中定时器的数目
+    uint64_t next_seq;                            // 下一个加入跳表的定时器的序号
+    timer_stats stats;                            // 运行统计
+};
+
+// 跳表定时器的统一适配接口
+template <typename T>
+struct timer_traits<skip_timer_lst<T> >
+{
+    typedef skip_timer<T> timer_type;
+
+    static timer_type* add_timer(skip_timer_lst<T>& lst, int timeout, void (*cb)(T), T data)
+    {
+        timer_type* timer = new timer_type;
+        timer->expire = timer_now() + timeout;
+        timer->cb_func = cb;
+        timer->user_data = data;
+        lst.add_timer(timer);
+        return timer;
+    }
+
+    static void del_timer(skip_timer_lst<T>& lst, timer_type* timer)
+    {
+        lst.del_timer(timer);
+    }
+};
+
+#endif
@@ -0,0 +1,214 @@
+/*
+    单链表时间轮：槽链表只用next一个32位下标串起来，节点存放在连续的节点数组中，空闲节点同样用next串成
+    空闲链表。没有prev下标，删除定时器时无法在O(1)内把节点从槽链表中摘下，所以删除只是给节点打上取消
+    标记；tick下一次遍历到该槽时顺手把它摘下并回收。一个被取消的节点最多在槽链表中多停留一周。
+
+    添加定时器时返回带代数的句柄timer_handle（见timer_handle.hpp），节点被回收时代数加1，已经到期或
+    被取消的定时器对应的句柄随即失效，再用它删除定时器是空操作，不会误删复用了同一个节点的新定时器。
+
+    每个节点16字节：后继下标、到期滴答数、调用者指定的编号（如文件描述符），以及共用一个32位字的
+    24位代数和8位回调函数编号。回调函数表最多登记255个回调函数。
+
+    从执行效率来看：
+        添加一个定时器的时间复杂度O(1)
+        删除一个定时器的时间复杂度O(1)
+        执行一个定时器的时间复杂度与时间轮相同，遍历时顺带回收被取消的节点
+*/
+
+#ifndef SLIM_WHEEL_TIMER_HPP
+#define SLIM_WHEEL_TIMER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "timer_handle.hpp"
+#include "timer_stats.hpp"
+
+// 单链表时间轮
+class slim_wheel
+{
+public:
+    typedef void (*callback)(uint32_t id);      // 回调函数，参数是添加定时器时指定的编号
+
+    static const uint32_t NIL = 0xffffffffu;    // 空下标
+
+    // slots是时间轮的槽数，每个槽对应一个滴答
+    explicit slim_wheel(int slots = 60)
+        : heads(slots > 0 ? slots : 1, static_cast<uint32_t>(NIL)), free_head(NIL), cur_tick(0), count(0), dead_num(0) {}
+
+    // 登记回调函数，返回它在回调函数表中的编号，表满时返回NIL
+    uint32_t register_callback(callback cb)
+    {
+        if(callbacks.size() >= CANCELLED)
+        {
+            return NIL;
+        }
+        callbacks.push_back(cb);
+        return static_cast<uint32_t>(callbacks.size() - 1);
+    }
+
+    // 添加一个timeout个滴答之后以cb_id号回调函数、以id为参数到期的定时器。cb_id不是register_callback
+    // 返回的编号（包括表满时返回的NIL）时不添加，返回INVALID_TIMER_HANDLE
+    timer_handle add_timer(uint32_t id, int timeout, uint32_t cb_id)
+    {
+        if(cb_id >= callbacks.size())
+        {
+            return INVALID_TIMER_HANDLE;
+        }
+        uint32_t index = alloc_node();
+        node& n = nodes[index];
+        n.deadline = cur_tick + (timeout < 1 ? 1 : static_cast<uint32_t>(timeout));
+        n.id = id;
+        n.tag = (n.tag & ~CB_MASK) | (cb_id & CB_MASK);
+        uint32_t& head = heads[n.deadline % heads.size()];
+        n.next = head;
+        head = index;
+        ++count;
+        stats.on_add();
+        timer_handle h = { index, generation(n) };
+        return h;
+    }
+
+    // 取消定时器：只打上取消标记并使句柄失效，节点在tick遍历到它所在的槽时回收
+    void del_timer(timer_handle h)
+    {
+        if(!pending(h))
+        {
+            return;
+        }
+        node& n = nodes[h.index];
+        n.tag = next_generation(n) | CANCELLED;
+        --count;
+        ++dead_num;
+        stats.on_cancel();
+        stats.set_tombstones(dead_num);
+    }
+
+    // 句柄是否指向一个尚未到期、也没有被取消的定时器
+    bool pending(timer_handle h) const
+    {
+        if(h.index >= nodes.size())
+        {
+            return false;
+        }
+        const node& n = nodes[h.index];
+        return generation(n) == h.generation && (n.tag & CB_MASK) != CANCELLED;
+    }
+
+    // 尚未到期、也没有被取消的定时器数目
+    int size() const
+    {
+        return count;
+    }
+
+    // 运行统计的快照，被取消但尚未回收的节点计为tombstones
+    timer_stats_snapshot get_stats() const
+    {
+        return stats.snapshot();
+    }
+
+    // 心搏函数，处理当前槽中到期的定时器并回收被取消的节点，然后转动到下一个槽
+    void tick()
+    {
+        timer_stats::tick_scope scope(stats);
+        uint32_t slot = cur_tick % heads.size();
+        uint64_t visited = 0;               // 访问过的节点数目，即当前槽的链表长度
+        uint32_t prev = NIL;                // 当前节点的前驱，NIL表示当前节点是槽链表的头
+        uint32_t index = heads[slot];
+        while(index != NIL)
+        {
+            node& n = nodes[index];
+            uint32_t cb_id = n.tag & CB_MASK;
+            ++visited;
+            if(cb_id != CANCELLED && static_cast<int32_t>(n.deadline - cur_tick) > 0)
+            {
+                prev = index;
+                index = n.next;
+                continue;
+            }
+            // 摘下到期或被取消的节点并回收，再执行到期定时器的任务。回调函数可能添加定时器使节点数组
+            // 重新分配，所以之后只通过下标访问节点
+            uint32_t id = n.id;
+            if(prev == NIL)
+            {
+                heads[slot] = n.next;
+            }
+            else
+            {
+                nodes[prev].next = n.next;
+            }
+            if(cb_id != CANCELLED)
+            {
+                n.tag = next_generation(n) | CANCELLED;
+                --count;
+                stats.on_fire(false);
+            }
+            else
+            {
+                --dead_num;
+            }
+            n.next = free_head;
+            free_head = index;
+            if(cb_id != CANCELLED)
+            {
+                callbacks[cb_id](id);
+            }
+            // 回调函数可能在当前槽的头部加入了新节点，从前驱重新取后继即可
+            index = prev == NIL ? heads[slot] : nodes[prev].next;
+        }
+        stats.on_slot(visited);
+        stats.set_tombstones(dead_num);
+        ++cur_tick;
+    }
+
+private:
+    static const uint32_t CB_MASK = 0xff;       // tag的低8位是回调函数编号
+    static const uint32_t CANCELLED = 0xff;     // 回调函数编号为它时表示定时器已到期或被取消
+    static const uint32_t GEN_ONE = 0x100;      // 代数加1对应的tag增量
+
+    // 16字节的定时器节点
+    struct node
+    {
+        uint32_t next;      // 槽链表或空闲链表中的后一个节点
+        uint32_t deadline;  // 到期的滴答数
+        uint32_t id;        // 调用者指定的编号，原样传给回调函数
+        uint32_t tag;       // 高24位是代数，低8位是回调函数编号
+    };
+
+    static uint32_t generation(const node& n)
+    {
+        return n.tag >> 8;
+    }
+
+    // 代数加1后的tag高24位，代数从1开始，回绕时跳过0
+    static uint32_t next_generation(const node& n)
+    {
+        uint32_t tag = (n.tag & ~CB_MASK) + GEN_ONE;
+        return tag ? tag : GEN_ONE;
+    }
+
+    uint32_t alloc_node()
+    {
+        if(free_head != NIL)
+        {
+            uint32_t index = free_head;
+            free_head = nodes[index].next;
+            return index;
+        }
+        node n = { NIL, 0, 0, GEN_ONE | CANCELLED };
+        nodes.push_back(n);
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+
+private:
+    std::vector<node> nodes;            // 节点数组
+    std::vector<uint32_t> heads;        // 时间轮的槽，每个元素是槽链表头节点的下标
+    std::vector<callback> callbacks;    // 回调函数表
+    uint32_t free_head;                 // 空闲链表的头
+    uint32_t cur_tick;                  // 当前滴答数
+    int count;                          // 尚未到期、也没有被取消的定时器数目
+    int dead_num;                       // 被取消但尚未回收的节点数目
+    timer_stats stats;                  // 运行统计
+};
+
+#endif
@@ -5,6 +5,15 @@
 
     时间堆定时器的数据结构和算法采用了最小堆，它是一个完全二叉树。
 
+    堆数组中的每个元素是(key, 定时器指针)，key把超时时间放在高32位、入堆序号放在低32位拼成一个64位整数。
+    上虑和下虑只比较数组中连续存放的key，不需要沿指针读取定时器；超时时间相同的定时器按入堆的先后到期。
+    超时时间按32位无符号数截取，足以表示到2106年的绝对秒数；入堆序号在约42亿次入堆后回绕，只影响回绕
+    前后入堆且超时时间相同的少数定时器之间的先后。
+
+    删除采用延迟销毁：del_timer只清空定时器的回调函数，但被延迟销毁的定时器超过一半时，del_timer会调用
+    compact当场释放这些节点。所以同一个定时器只能删除一次，删除或到期之后调用者不能再使用它的指针。一次性
+    定时器在执行回调函数之前就清空了回调函数，回调函数中删除它自己是安全的空操作。
+
     从执行效率来看：
         添加一个定时器的时间复杂度O(logn)
         删除一个定时器的时间复杂度O(1)
@@ -15,213 +24,552 @@
 #define TIME_HEAP_TIMER_HPP
 
 #include <iostream>
-#include <netinet/in.h>
+#include <stdint.h>
 #include <time.h>
+#include "timer_clock.hpp"
+#include "timer_group.hpp"
+#include "timer_pool.hpp"
+#include "timer_stats.hpp"
+#include "timer_traits.hpp"
+#ifdef TIMER_HUGE_PAGES
+#include "huge_page.hpp"
+#endif
 using std::exception;
 
-#define BUFFER_SIZE 64
-class heap_timer;
-
-// 用户数据结构
-struct client_data
+// 提示CPU把[first, last]覆盖的每一条64字节缓存行预取到缓存中，不支持的编译器上什么也不做。
+// 一段连续的元素即使不超过128字节，起点不对齐时也可能跨三条缓存行
+inline void timer_prefetch(const void* first, const void* last)
 {
-    sockaddr_in address;    // 客户端socket地址
-    int sockfd;             // socket文件描述符
-    char buf[BUFFER_SIZE];  // 读缓存
-    heap_timer* timer;      // 定时器
-};
+#if defined(__GNUC__)
+    uintptr_t line = reinterpret_cast<uintptr_t>(first) & ~static_cast<uintptr_t>(63);
+    for(; line <= reinterpret_cast<uintptr_t>(last); line += 64)
+    {
+        __builtin_prefetch(reinterpret_cast<const void*>(line));
+    }
+#else
+    (void)first;
+    (void)last;
+#endif
+}
 
 // 定时器类
+// 模板参数T是定时器携带的用户数据类型，按值存放在节点中并原样传给回调函数
+template <typename T>
 class heap_timer
 {
 public:
-    heap_timer(int delay)
+    heap_timer(int delay) : period(0), group(nullptr), group_prev(nullptr), group_next(nullptr)
     {
-        expire = time(NULL) + delay;
+        expire = timer_now() + delay;
     }
+
+    // 节点从线程本地的内存池中分配
+    static void* operator new(size_t size) { return timer_pool::allocate(size); }
+    static void operator delete(void* p, size_t size) { timer_pool::release(p, size); }
 public:
     time_t expire;                  // 定时器生效的绝对时间
-    void (*cb_func)(client_data*);  // 定时器回调函数
-    client_data* user_data;         // 用户数据
+    time_t period;                  // 周期定时器的重复间隔（秒），为0表示一次性定时器
+    void (*cb_func)(T);             // 定时器回调函数
+    T user_data;                    // 用户数据
+    timer_group<heap_timer>* group; // 定时器所属的组
+    heap_timer* group_prev;         // 组链表中的前一个定时器
+    heap_timer* group_next;         // 组链表中的后一个定时器
+};
+
+// 时间堆、多叉时间堆和分页时间堆共用的延迟销毁、压缩、弹出和tick逻辑。三者的定时器节点、key和被延迟
+// 销毁的定时器的处理完全相同，区别只在于元素怎样存放、孩子的下标怎样计算。Derived是具体的堆，它只负责
+// 元素的存放，需要提供下面这些函数（可以是私有的，把本类声明为友元即可）：
+//     timer_type* timer_at(int i) const;                      // 逻辑下标为i的定时器
+//     void reserve(int n);                                    // 保证数组至少能容纳n个元素
+//     void push(int hole, uint64_t key, timer_type* timer);   // 把新元素放入空位hole并上虑
+//     void rekey_top(uint64_t key);                           // 替换堆顶元素的key并下虑
+//     void fill_top(int last);                                // 用逻辑下标为last的元素填补堆顶的空位并下虑
+//     void move_entry(int from, int to);                      // 压缩时把元素从from搬到to
+//     void heapify();                                         // 对前cur_size个元素重新建堆
+// Derived可以定义自己的compact，在调用本类的compact之后做额外的工作，del_timer会调用它
+template <typename Derived, typename T>
+class lazy_heap_base
+{
+public:
+    typedef heap_timer<T> timer_type;
+
+    // 删除目标定时器timer
+    void del_timer(timer_type* timer)
+    {
+        if(!timer)
+        {
+            return;
+        }
+        // 仅仅将目标定时器的回调函数设置为空，即所谓的延迟销毁。这将节省真正删除该定时器
+        // 造成的开销，但这样做也容易使堆数组膨胀，所以当被延迟销毁的定时器超过一半时就压缩整个堆
+        timer_group<timer_type>::leave(timer);
+        if(timer->cb_func)
+        {
+            timer->cb_func = nullptr;
+            ++dead_num;
+            stats.on_cancel();
+        }
+        if(cur_size >= COMPACT_MIN && dead_num * 2 > cur_size)
+        {
+            derived().compact();
+        }
+        stats.set_tombstones(dead_num);
+    }
+
+    // 删除组中的所有定时器。组链表直接给出了每个节点，逐个做延迟销毁标记；如果被标记的定时器占了
+    // 堆的一半以上，del_timer会用一次O(n)的重建代替它们各自在tick中的弹出
+    void del_group(timer_group<timer_type>& group)
+    {
+        while(!group.empty())
+        {
+            del_timer(group.front());
+        }
+    }
+
+    // 销毁所有被延迟销毁的定时器，然后对剩下的定时器重新建堆
+    void compact()
+    {
+        int size = 0;
+        for(int i = 0; i < cur_size; ++i)
+        {
+            timer_type* timer = derived().timer_at(i);
+            if(timer->cb_func)
+            {
+                derived().move_entry(i, size++);
+            }
+            else
+            {
+                delete timer;
+            }
+        }
+        cur_size = size;
+        dead_num = 0;
+        stats.set_tombstones(0);
+        derived().heapify();
+    }
+
+    // 获得堆顶部的定时器
+    timer_type* top() const
+    {
+        if(empty())
+        {
+            return nullptr;
+        }
+        return derived().timer_at(0);
+    }
+
+    // 删除堆顶部的定时器
+    void pop_timer()
+    {
+        if(empty())
+        {
+            return;
+        }
+        timer_type* tmp = derived().timer_at(0);
+        timer_group<timer_type>::leave(tmp);
+        if(!tmp->cb_func)
+        {
+            --dead_num;
+            stats.set_tombstones(dead_num);
+        }
+        else
+        {
+            stats.on_cancel();
+        }
+        delete tmp;
+        remove_top();
+    }
+
+    // 心搏函数
+    void tick()
+    {
+        timer_stats::tick_scope scope(stats);
+        time_t cur = timer_now();
+        // 循环处理堆数组中到期的定时器
+        while(!empty())
+        {
+            timer_type* tmp = derived().timer_at(0);
+            // 如果堆顶定时器没有到期，则退出循环
+            if(tmp->expire > cur)
+            {
+                break;
+            }
+            // 未被删除的周期定时器原地重新入队：超时时间加上周期后直接对堆顶执行下虑操作，不需要弹出再插入，
+            // 也不需要重新分配节点
+            if(tmp->period > 0 && tmp->cb_func)
+            {
+                tmp->expire = timer_next_expire(tmp->expire, tmp->period, cur);
+                derived().rekey_top(make_key(tmp));
+                stats.on_fire(true);
+                tmp->cb_func(tmp->user_data);
+                continue;
+            }
+            // 先把堆顶定时器从堆中取出，同时生成新的堆顶定时器，再执行其中的任务。这样回调函数中新添加的
+            // 定时器即使成为了堆顶，也不会被当作刚执行完的定时器删除
+            remove_top();
+            timer_group<timer_type>::leave(tmp);
+            void (*cb)(T) = tmp->cb_func;
+            if(cb)
+            {
+                // 节点已经离开堆，先清空回调函数，回调函数中对它自己调用del_timer就成了空操作
+                tmp->cb_func = nullptr;
+                stats.on_fire(false);
+                cb(tmp->user_data);
+            }
+            else
+            {
+                --dead_num;
+            }
+            delete tmp;
+        }
+        stats.set_tombstones(dead_num);
+    }
+
+    // 堆数组是否为空
+    bool empty() const
+    {
+        return 0 == cur_size;
+    }
+
+    // 堆数组中的元素个数，包括被延迟销毁的定时器
+    int size() const
+    {
+        return cur_size;
+    }
+
+    // 仍然有效的定时器个数
+    int live_size() const
+    {
+        return cur_size - dead_num;
+    }
+
+    // 被延迟销毁、尚未从堆数组中移除的定时器个数
+    int dead_size() const
+    {
+        return dead_num;
+    }
+
+    // 运行统计的快照
+    timer_stats_snapshot get_stats() const
+    {
+        return stats.snapshot();
+    }
+
+protected:
+    lazy_heap_base() : cur_size(0), dead_num(0), next_seq(0) {}
+
+    // 添加目标定时器，数组不够时由Derived扩容
+    void push_timer(timer_type* timer)
+    {
+        if(!timer)
+        {
+            throw std::exception();
+        }
+        derived().reserve(cur_size + 1);
+        admit(timer);
+        stats.set_tombstones(dead_num);
+        derived().push(cur_size++, make_key(timer), timer);
+    }
+
+    // 统计一个即将入堆的定时器，回调函数为空的定时器入堆时就是被延迟销毁的
+    void admit(const timer_type* timer)
+    {
+        if(!timer->cb_func)
+        {
+            ++dead_num;
+        }
+        else
+        {
+            stats.on_add();
+        }
+    }
+
+    // 为定时器分配新的入堆序号并生成它的key：高32位是超时时间，低32位是入堆序号，两个key不会相等
+    uint64_t make_key(const timer_type* timer)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(timer->expire)) << 32) | next_seq++;
+    }
+
+    // 销毁堆中所有的定时器，由Derived的析构函数在释放数组之前调用
+    void destroy_timers()
+    {
+        for(int i = 0; i < cur_size; ++i)
+        {
+            timer_type* tmp = derived().timer_at(i);
+            timer_group<timer_type>::leave(tmp);
+            delete tmp;
+        }
+    }
+
+    Derived& derived()
+    {
+        return *static_cast<Derived*>(this);
+    }
+
+    const Derived& derived() const
+    {
+        return *static_cast<const Derived*>(this);
+    }
+
+private:
+    // 用最后一个元素填补堆顶的空位
+    void remove_top()
+    {
+        --cur_size;
+        derived().fill_top(cur_size);
+    }
+
+protected:
+    int cur_size;       // 堆数组当前包含元素的个数
+    int dead_num;       // 堆数组中被延迟销毁的定时器个数
+    uint32_t next_seq;  // 下一个入堆的定时器的序号
+    timer_stats stats;  // 运行统计
+
+    static const int COMPACT_MIN = 64;  // 堆中元素少于这个数时不自动压缩
 };
 
 // 时间堆类
-class time_heap
+template <typename T>
+class time_heap : public lazy_heap_base<time_heap<T>, T>
 {
+    typedef lazy_heap_base<time_heap, T> base;
+    friend class lazy_heap_base<time_heap, T>;
+    using base::cur_size;
+    using base::dead_num;
+    using base::stats;
+public:
+    typedef heap_timer<T> timer_type;
+
 public:
     // 构造函数之一：初始化一个大小为cap的空堆
-    time_heap(int cap) throw(std::exception) : capacity(cap), cur_size(0)
+    time_heap(int cap) : capacity(cap), init_capacity(cap)
     {
         // 创建堆数组
-        array = new heap_timer*[capacity];
+        array = allocate_array(capacity);
         if(!array)
         {
             throw std::exception();
         }
-        for(int i = 0; i < capacity; ++i)
-        {
-            array[i] = nullptr;
-        }
     }
 
     // 构造函数之二：用已有的数组来初始化堆
-    time_heap(heap_timer** init_array, int size, int capacity) throw(std::exception) : 
-        capacity(capacity), cur_size(size)
+    time_heap(timer_type** init_array, int size, int capacity) : 
+        capacity(capacity), init_capacity(capacity)
     {
         if(capacity < size)
         {
             throw std::exception();
         }
+        cur_size = size;
         // 创建堆数组
-        array = new heap_timer*[capacity];
+        array = allocate_array(capacity);
         if(!array)
         {
             throw std::exception();
         }
-        for(int i = 0; i < capacity; ++i)
-        {
-            array[i] = nullptr;
-        }
         if(size != 0)
         {
-            // 初始化堆数组
+            // 初始化堆数组，超时时间相同的定时器按它们在init_array中的先后到期
             for(int i = 0; i < size; ++i)
             {
-                array[i] = init_array[i];
-            }
-            for(int i = (cur_size-1)/2; i >= 0; i--)
-            {
-                // 对数组中的第[(cur_size-1)/2]~0个元素进行下虑操作
-                percolate_down(i);
+                array[i] = make_entry(init_array[i]);
+                this->admit(init_array[i]);
             }
+            stats.set_tombstones(dead_num);
+            heapify();
         }
     }
 
     // 销毁时间堆
     ~time_heap()
     {
-        for(int i = 0; i < cur_size; ++i)
-        {
-            delete array[i];
-        }
-        delete []array;
+        this->destroy_timers();
+        release_array(array, capacity);
     }
 public:
     // 添加目标定时器
-    void add_timer(heap_timer* timer) throw(std::exception)
+    void add_timer(timer_type* timer)
     {
-        if(!timer)
+        this->push_timer(timer);
+    }
+
+    // 批量添加定时器，用于服务重启时一次性恢复大量定时器。新定时器先全部追加到堆数组末尾，如果逐个上虑的
+    // 代价n*log(size)超过了对整个数组重新建堆的代价（约2*size次比较），就用Floyd建堆法在O(size)内完成
+    void add_timers(timer_type** timers, int n)
+    {
+        if(!timers || n <= 0)
         {
-            throw std::exception();
+            return;
         }
-        // 如果当前堆数组容量不够，扩大一倍容量
-        if(cur_size >= capacity)
+        // 先检查全部定时器再修改堆的状态，抛出异常时堆和统计都保持原样
+        for(int i = 0; i < n; ++i)
         {
-            resize();
+            if(!timers[i])
+            {
+                throw std::exception();
+            }
         }
-        // 新插入了一个元素，当前堆的大小加1，hole是新建空节点的位置
-        int hole = cur_size++;
-        int parent = 0;
-        // 对从空节点到根节点的路径上的所有节点执行上虑操作
-        for(; hole > 0; hole = parent)
+        reserve(cur_size + n);
+        for(int i = 0; i < n; ++i)
         {
-            // 计算父节点的位置
-            parent = (hole-1)/2;
-            if(array[parent]->expire <= timer->expire)
+            this->admit(timers[i]);
+        }
+        stats.set_tombstones(dead_num);
+        int size = cur_size + n;
+        int depth = 0;
+        for(int i = size; i > 1; i >>= 1)
+        {
+            ++depth;
+        }
+        if(static_cast<long long>(n) * depth > 2LL * size)
+        {
+            for(int i = 0; i < n; ++i)
             {
-                break;
+                array[cur_size++] = make_entry(timers[i]);
+            }
+            heapify();
+        }
+        else
+        {
+            for(int i = 0; i < n; ++i)
+            {
+                percolate_up(cur_size++, make_entry(timers[i]));
             }
-            array[hole] = array[parent];
         }
-        array[hole] = timer;
     }
 
-    // 删除目标定时器timer
-    void del_timer(heap_timer* timer)
+    // 销毁所有被延迟销毁的定时器，然后对剩下的定时器重新建堆。如果堆数组的利用率因此低于1/4，
+    // 则把容量收缩到当前大小的两倍（但不小于构造时的容量），让流量高峰过后内存回到基线
+    void compact()
     {
-        if(!timer)
+        base::compact();
+        if(capacity > init_capacity && cur_size < capacity / 4)
         {
-            return;
+            reallocate(2*cur_size > init_capacity ? 2*cur_size : init_capacity);
         }
-        // 仅仅将目标定时器的回调函数设置为空，即所谓的延迟销毁。这将节省真正删除该定时器
-        // 造成的开销，但这样做也容易使堆数组膨胀
-        timer->cb_func = nullptr;
     }
 
-    // 获得堆顶部的定时器
-    heap_timer* top() const
+    // 压缩堆并把容量收缩到恰好容纳当前的定时器
+    void shrink_to_fit()
     {
-        if(empty())
+        compact();
+        if(capacity > cur_size)
         {
-            return nullptr;
+            reallocate(cur_size > 0 ? cur_size : 1);
         }
-        return array[0];
     }
 
-    // 删除堆顶部的定时器
-    void pop_timer()
+    // 堆数组的容量
+    int array_capacity() const
     {
-        if(empty())
-        {
-            return;
-        }
-        if(array[0])
+        return capacity;
+    }
+private:
+    // 堆数组的元素：key的高32位是超时时间，低32位是入堆序号，两个key不会相等
+    struct entry
+    {
+        uint64_t key;
+        timer_type* timer;
+    };
+
+    entry make_entry(timer_type* timer)
+    {
+        entry e;
+        e.key = this->make_key(timer);
+        e.timer = timer;
+        return e;
+    }
+
+    timer_type* timer_at(int i) const
+    {
+        return array[i].timer;
+    }
+
+    // 如果当前堆数组容量不够，每次扩大一倍容量
+    void reserve(int n)
+    {
+        while(n > capacity)
         {
-            delete array[0];
-            // 将原来的堆顶元素替换为堆数组中最后一个元素
-            array[0] = array[--cur_size];
-            // 对堆数组执行下虑操作
-            percolate_down(0);
+            resize();
         }
     }
 
-    // 心搏函数
-    void tick()
+    // 新插入了一个元素，hole是新建空节点的位置
+    void push(int hole, uint64_t key, timer_type* timer)
     {
-        heap_timer* tmp = array[0];
-        time_t cur = time(NULL);
-        // 循环处理堆数组中到期的定时器
-        while(!empty())
+        entry e;
+        e.key = key;
+        e.timer = timer;
+        percolate_up(hole, e);
+    }
+
+    void rekey_top(uint64_t key)
+    {
+        array[0].key = key;
+        percolate_down(0);
+    }
+
+    // 将原来的堆顶元素替换为堆数组中最后一个元素，再对堆数组执行下虑操作
+    void fill_top(int last)
+    {
+        array[0] = array[last];
+        percolate_down(0);
+    }
+
+    void move_entry(int from, int to)
+    {
+        array[to] = array[from];
+    }
+
+    // 最小堆的上虑操作：把e放入空节点hole，并对从hole到根节点的路径执行上虑操作
+    void percolate_up(int hole, entry e)
+    {
+        int parent = 0;
+        for(; hole > 0; hole = parent)
         {
-            if(!tmp)
-            {
-                break;
-            }
-            // 如果堆顶定时器没有到期，则退出循环
-            if(tmp->expire > cur)
+            // 计算父节点的位置
+            parent = (hole-1)/2;
+            if(array[parent].key < e.key)
             {
                 break;
             }
-            // 否则就执行堆顶定时器中的任务
-            if(array[0]->cb_func)
-            {
-                array[0]->cb_func(array[0]->user_data);
-            }
-            // 删除堆顶定时器，同时生成新的堆顶定时器
-            pop_timer();
-            tmp = array[0];
+            array[hole] = array[parent];
         }
+        array[hole] = e;
     }
 
-    // 堆数组是否为空
-    bool empty() const
+    // 对数组中的第[(cur_size-1)/2]~0个元素进行下虑操作，使整个数组成为最小堆
+    void heapify()
     {
-        return 0 == cur_size;
+        for(int i = (cur_size-1)/2; i >= 0; i--)
+        {
+            percolate_down(i);
+        }
     }
-private:
-    // 最小堆的下虑操作，它确保堆数组中以第hole个节点作为根的子树拥有最小堆的性质
+
+    // 最小堆的下虑操作，它确保堆数组中以第hole个节点作为根的子树拥有最小堆的性质。堆很大时下面几层
+    // 每一层都是一次缓存未命中，所以在比较孩子之前先预取hole往下第三层的8个元素。它们共128字节，从
+    // 第128*hole+112字节开始，跨三条缓存行，等下虑走到那一层时它们已经在缓存中了
     void percolate_down(int hole)
     {
-        heap_timer* temp = array[hole];
+        entry temp = array[hole];
         int child = 0;
         for(; ((hole*2+1) <= cur_size - 1); hole = child)
         {
+            // 用size_t计算，hole超过2^28时int会溢出；末尾夹在最后一个元素上，不在数组之外形成指针
+            size_t great = static_cast<size_t>(hole)*8+7;
+            size_t size = static_cast<size_t>(cur_size);
+            if(great < size)
+            {
+                timer_prefetch(&array[great], &array[great + 7 < size ? great + 7 : size - 1]);
+            }
             child = hole*2+1;
-            if(child < (cur_size - 1) && array[child + 1]->expire < array[child]->expire)
+            // key互不相等，较小的孩子由一次比较决定，编译器可以生成无分支的代码
+            if(child < (cur_size - 1))
             {
-                ++child;
+                child += array[child + 1].key < array[child].key;
             }
-            if(array[child]->expire < temp->expire)
+            if(array[child].key < temp.key)
             {
                 array[hole] = array[child];
             }
@@ -234,29 +582,95 @@ private:
     }
 
     // 将堆数组容量扩大一倍
-    void resize() throw(std::exception)
+    void resize()
+    {
+        reallocate(capacity > 0 ? 2*capacity : 1);
+    }
+
+    // 把堆数组的容量调整为new_capacity，new_capacity不能小于cur_size
+    void reallocate(int new_capacity)
     {
-        heap_timer** temp = new heap_timer*[2*capacity];
-        for(int i = 0; i < 2*capacity; ++i)
+#ifdef TIMER_HUGE_PAGES
+        if(use_huge_page(capacity) && use_huge_page(new_capacity))
         {
-            temp[i] = nullptr;
+            // 新旧数组都在大页上时用mremap整体搬移，不需要逐个复制元素
+            array = static_cast<entry*>(huge_page::reallocate(array, capacity * sizeof(entry),
+                                                               new_capacity * sizeof(entry)));
+            capacity = new_capacity;
+            return;
         }
+#endif
+        entry* temp = allocate_array(new_capacity);
         if(!temp)
         {
             throw std::exception();
         }
-        capacity = 2*capacity;
         for(int i = 0; i < cur_size; ++i)
         {
             temp[i] = array[i];
         }
-        delete []array;
+        release_array(array, capacity);
+        capacity = new_capacity;
         array = temp;
     }
+
+    // 分配能容纳n个元素的堆数组。定义了TIMER_HUGE_PAGES时，达到一个大页的数组改用大页内存
+    static entry* allocate_array(int n)
+    {
+#ifdef TIMER_HUGE_PAGES
+        if(use_huge_page(n))
+        {
+            return static_cast<entry*>(huge_page::allocate(n * sizeof(entry)));
+        }
+#endif
+        return new entry[n];
+    }
+
+    static void release_array(entry* a, int n)
+    {
+#ifdef TIMER_HUGE_PAGES
+        if(use_huge_page(n))
+        {
+            huge_page::release(a, n * sizeof(entry));
+            return;
+        }
+#else
+        (void)n;
+#endif
+        delete []a;
+    }
+
+#ifdef TIMER_HUGE_PAGES
+    static bool use_huge_page(int n)
+    {
+        return static_cast<size_t>(n) * sizeof(entry) >= huge_page::SIZE;
+    }
+#endif
 private:
-    heap_timer** array; // 堆数组
+    entry* array;       // 堆数组
     int capacity;       // 堆数组的容量
-    int cur_size;       // 对数组当前包含元素的个数
+    int init_capacity;  // 构造时的容量，自动收缩不会低于它
+};
+
+// 时间堆的统一适配接口
+template <typename T>
+struct timer_traits<time_heap<T> >
+{
+    typedef heap_timer<T> timer_type;
+
+    static timer_type* add_timer(time_heap<T>& heap, int timeout, void (*cb)(T), T data)
+    {
+        timer_type* timer = new timer_type(timeout);
+        timer->cb_func = cb;
+        timer->user_data = data;
+        heap.add_timer(timer);
+        return timer;
+    }
+
+    static void del_timer(time_heap<T>& heap, timer_type* timer)
+    {
+        heap.del_timer(timer);
+    }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,274 @@
+/*
+    混合定时器：大多数定时器在一分钟之内到期，但也有一小部分要几个小时后才到期。时间轮处理近期定时器
+    的效率很高，但远期定时器需要转很多圈，每一圈都要在tick中被访问一次；时间堆不在乎定时器有多远，但
+    它的O(logn)代价随着定时器总数增长。混合定时器把距离到期不足时间轮一周（time_wheel::horizon()）的
+    定时器放入时间轮，把更远的定时器放入时间堆，每次tick先把堆顶已经进入时间轮范围的定时器迁移到
+    时间轮中，再转动时间轮。这样时间轮中的定时器都不需要转圈，时间堆中只保留为数不多的远期定时器。
+
+    tick应当每隔time_wheel::interval()秒被调用一次。定时器在第一次满足当前时间不小于expire的tick中到期，
+    与时间堆相同：放入时间轮时按超时时间算出它在此后第几次tick到期，而不是把剩余时间交给时间轮折合。
+    两次tick之间添加的定时器假定下一次tick在一个槽间隔之后，如果这一秒的tick还没有发生，定时器会提前
+    一次被时间轮访问，这时它发现尚未到期，重新放回时间轮等待下一次tick。
+
+    从执行效率来看：
+        添加一个近期定时器的时间复杂度O(1)，远期定时器O(logm)，m为远期定时器的数目
+        删除一个定时器的时间复杂度O(1)
+        执行一个定时器的时间复杂度O(1)，每个远期定时器另有一次O(logm)的迁移
+*/
+
+#ifndef TIME_HYBRID_TIMER_HPP
+#define TIME_HYBRID_TIMER_HPP
+
+#include <time.h>
+#include "time_heap_timer.hpp"
+#include "time_wheel_timer.hpp"
+#include "timer_clock.hpp"
+#include "timer_pool.hpp"
+#include "timer_stats.hpp"
+#include "timer_traits.hpp"
+
+template <typename T>
+class time_hybrid;
+
+// 定时器类
+template <typename T>
+class hybrid_timer
+{
+public:
+    hybrid_timer() : period(0), owner(nullptr), wheel_node(nullptr), heap_node(nullptr) {}
+
+    // 节点从线程本地的内存池中分配
+    static void* operator new(size_t size) { return timer_pool::allocate(size); }
+    static void operator delete(void* p, size_t size) { timer_pool::release(p, size); }
+public:
+    time_t expire;                              // 定时器生效的绝对时间
+    time_t period;                              // 周期定时器的重复间隔（秒），为0表示一次性定时器
+    void (*cb_func)(T);                         // 定时器回调函数
+    T user_data;                                // 用户数据
+    time_hybrid<T>* owner;                      // 定时器所属的混合定时器
+    tw_timer<hybrid_timer*>* wheel_node;        // 定时器位于时间轮中时对应的节点
+    heap_timer<hybrid_timer*>* heap_node;       // 定时器位于时间堆中时对应的节点
+};
+
+// 混合定时器
+template <typename T>
+class time_hybrid
+{
+public:
+    typedef hybrid_timer<T> timer_type;
+
+    // cap是时间堆的初始容量
+    explicit time_hybrid(int cap = 64) : heap(cap) {}
+
+    // 时间轮和时间堆只负责销毁它们自己的节点，混合定时器本身在这里销毁
+    ~time_hybrid()
+    {
+        while(!heap.empty())
+        {
+            heap_timer<timer_type*>* top = heap.top();
+            if(top->cb_func)
+            {
+                delete top->user_data;
+            }
+            heap.pop_timer();
+        }
+        while(!wheel_timers.empty())
+        {
+            tw_timer<timer_type*>* node = wheel_timers.front();
+            timer_type* timer = node->user_data;
+            wheel.del_timer(node);
+            delete timer;
+        }
+    }
+
+    // 添加目标定时器，调用者事先填好它的超时时间expire
+    void add_timer(timer_type* timer)
+    {
+        if(!timer)
+        {
+            return;
+        }
+        timer->owner = this;
+        stats.on_add();
+        schedule(timer, timer_now() + wheel_type::interval());
+    }
+
+    // 删除目标定时器
+    void del_timer(timer_type* timer)
+    {
+        // 回调函数为空的定时器正在执行它的一次性任务，已经离开时间轮和时间堆，由tick负责销毁
+        if(!timer || !timer->cb_func)
+        {
+            return;
+        }
+        stats.on_cancel();
+        unschedule(timer);
+        delete timer;
+    }
+
+    // 调用者修改了timer->expire之后调用该函数重新安排定时器
+    void adjust_timer(timer_type* timer)
+    {
+        if(!timer)
+        {
+            return;
+        }
+        unschedule(timer);
+        schedule(timer, timer_now() + wheel_type::interval());
+    }
+
+    // 心搏函数，每隔time_wheel::interval()秒调用一次
+    void tick()
+    {
+        timer_stats::tick_scope scope(stats);
+        time_t cur = timer_now();
+        // 把已经进入时间轮范围的远期定时器从堆顶迁移到时间轮中，被删除的定时器顺便销毁
+        while(!heap.empty())
+        {
+            heap_timer<timer_type*>* top = heap.top();
+            if(top->cb_func)
+            {
+                if(top->expire - cur >= wheel_type::horizon())
+                {
+                    break;
+                }
+                timer_type* timer = top->user_data;
+                timer->heap_node = nullptr;
+                heap.pop_timer();
+                schedule(timer, cur);
+            }
+            else
+            {
+                heap.pop_timer();
+            }
+        }
+        wheel.tick();
+        stats.set_tombstones(heap.dead_size());
+    }
+
+    // 时间轮中的近期定时器数目和时间堆中的远期定时器数目
+    int near_size() const
+    {
+        return static_cast<int>(wheel_timers.size());
+    }
+
+    int far_size() const
+    {
+        return heap.live_size();
+    }
+
+    // 运行统计的快照，槽的长度取自内部的时间轮
+    timer_stats_snapshot get_stats() const
+    {
+        timer_stats_snapshot s = stats.snapshot();
+        s.max_slot_len = wheel.get_stats().max_slot_len;
+        return s;
+    }
+
+private:
+    typedef time_wheel<timer_type*> wheel_type;
+    typedef time_heap<timer_type*> heap_type;
+
+    // 按距离到期的时间把定时器放入时间轮或时间堆。next是下一次tick对应的时间，定时器在从它开始的
+    // 第n次tick到期，n使得这次tick的时间不早于expire
+    void schedule(timer_type* timer, time_t next)
+    {
+        time_t delay = timer->expire - next;
+        if(delay < wheel_type::horizon())
+        {
+            int si = wheel_type::interval();
+            int n = delay > 0 ? static_cast<int>((delay + si - 1) / si) + 1 : 1;
+            timer->wheel_node = wheel.add_timer_in_ticks(n);
+            timer->wheel_node->cb_func = &time_hybrid::fire;
+            timer->wheel_node->user_data = timer;
+            // 所有位于时间轮中的节点组成一个组，析构时用它找到它们
+            wheel_timers.join(timer->wheel_node);
+        }
+        else
+        {
+            heap_timer<timer_type*>* node = new heap_timer<timer_type*>(0);
+            node->expire = timer->expire;
+            node->cb_func = &time_hybrid::migrate;
+            node->user_data = timer;
+            timer->heap_node = node;
+            heap.add_timer(node);
+        }
+    }
+
+    // 把定时器从时间轮或时间堆中摘下
+    void unschedule(timer_type* timer)
+    {
+        if(timer->wheel_node)
+        {
+            wheel.del_timer(timer->wheel_node);
+            timer->wheel_node = nullptr;
+        }
+        if(timer->heap_node)
+        {
+            heap.del_timer(timer->heap_node);
+            timer->heap_node = nullptr;
+        }
+    }
+
+    // 时间轮中的定时器到期
+    static void fire(timer_type* timer)
+    {
+        timer->wheel_node = nullptr;
+        time_t cur = timer_now();
+        time_t next = cur + wheel_type::interval();
+        // 两次tick之间添加的定时器可能被提前访问，放回时间轮等待下一次tick
+        if(timer->expire > cur)
+        {
+            timer->owner->schedule(timer, next);
+            return;
+        }
+        // 周期定时器按新的超时时间重新选择放入时间轮还是时间堆
+        if(timer->period > 0)
+        {
+            timer->expire = timer_next_expire(timer->expire, timer->period, cur);
+            timer->owner->schedule(timer, next);
+            timer->owner->stats.on_fire(true);
+            timer->cb_func(timer->user_data);
+            return;
+        }
+        // 先清空回调函数再执行，回调函数中对它自己调用del_timer就成了空操作
+        void (*cb)(T) = timer->cb_func;
+        timer->cb_func = nullptr;
+        timer->owner->stats.on_fire(false);
+        cb(timer->user_data);
+        delete timer;
+    }
+
+    // 时间堆中的节点只在tick中被迁移，从不由时间堆自己执行
+    static void migrate(timer_type*) {}
+
+private:
+    wheel_type wheel;                           // 近期定时器
+    heap_type heap;                             // 远期定时器
+    timer_group<tw_timer<timer_type*> > wheel_timers;   // 时间轮中的所有节点
+    timer_stats stats;                          // 运行统计
+};
+
+// 混合定时器的统一适配接口
+template <typename T>
+struct timer_traits<time_hybrid<T> >
+{
+    typedef hybrid_timer<T> timer_type;
+
+    static timer_type* add_timer(time_hybrid<T>& hybrid, int timeout, void (*cb)(T), T data)
+    {
+        timer_type* timer = new timer_type;
+        timer->expire = timer_now() + timeout;
+        timer->cb_func = cb;
+        timer->user_data = data;
+        hybrid.add_timer(timer);
+        return timer;
+    }
+
+    static void del_timer(time_hybrid<T>& hybrid, timer_type* timer)
+    {
+        hybrid.del_timer(timer);
+    }
+};
+
+#endif
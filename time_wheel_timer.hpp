@@ -22,40 +22,47 @@
 #define TIME_WHEEL_TIMER_H
 
 #include <time.h>
-#include <netinet/in.h>
-#include <stdio.h>
-
-#define BUFFER_SIZE 64
-class tw_timer;
-
-// 用户数据结构
-struct client_data
-{
-    sockaddr_in address;    // 客户端socket地址
-    int sockfd;             // socket文件描述符
-    char buf[BUFFER_SIZE];  // 读缓存
-    tw_timer* timer;      // 定时器
-};
+#include "timer_pool.hpp"
+#include "timer_group.hpp"
+#include "timer_log.hpp"
+#include "timer_stats.hpp"
+#include "timer_traits.hpp"
 
 // 定时器类
+// 模板参数T是定时器携带的用户数据类型，按值存放在节点中并原样传给回调函数
+template <typename T>
 class tw_timer
 {
 public:
-    tw_timer(int rot, int ts) : next(nullptr), prev(nullptr), rotation(rot), time_slot(ts) {}
+    tw_timer(int rot, int ts)
+        : rotation(rot), time_slot(ts), period(0), group(nullptr), next(nullptr), prev(nullptr),
+          group_prev(nullptr), group_next(nullptr) {}
+
+    // 节点从线程本地的内存池中分配
+    static void* operator new(size_t size) { return timer_pool::allocate(size); }
+    static void operator delete(void* p, size_t size) { timer_pool::release(p, size); }
 public:
     int rotation;                   // 记录定时器在时间轮转多少圈后生效
     int time_slot;                  // 记录定时器属于时间轮上哪个槽（对应的链表）
-    void (*cb_func)(client_data*);  // 定时器回调函数
-    client_data* user_data;         // 客户数据
+    int period;                     // 周期定时器的重复间隔（秒），为0表示一次性定时器
+    void (*cb_func)(T);             // 定时器回调函数
+    T user_data;                    // 客户数据
+    timer_group<tw_timer>* group;   // 定时器所属的组
     tw_timer* next;                 // 指向下一个定时器
     tw_timer* prev;                 // 指向前一个定时器
+    tw_timer* group_prev;           // 组链表中的前一个定时器
+    tw_timer* group_next;           // 组链表中的后一个定时器
 };
 
 // 时间轮类
+template <typename T>
 class time_wheel
 {
 public:
-    time_wheel() : cur_slot(0)
+    typedef tw_timer<T> timer_type;
+
+public:
+    time_wheel() : cur_slot(0), cursor(nullptr), ticking(false)
     {
         for(int i = 0; i < N; ++i)
         {
@@ -69,10 +76,11 @@ public:
         // 遍历每一个槽，并销毁其中的定时器
         for(int i = 0; i < N; ++i)
         {
-            tw_timer* tmp = slots[i];
+            timer_type* tmp = slots[i];
             while(tmp)
             {
                 slots[i] = tmp->next;
+                timer_group<timer_type>::leave(tmp);
                 delete tmp;
                 tmp = slots[i];
             }
@@ -80,7 +88,7 @@ public:
     }
 
     // 根据定时值timeout创建一个定时器，并把它插入合适的槽中
-    tw_timer* add_timer(int timeout)
+    timer_type* add_timer(int timeout)
     {
         if(timeout < 0)
         {
@@ -99,16 +107,17 @@ public:
         {
             ticks = timeout / SI;
         }
-        // 计算待插入的定时器在时间轮转动多少圈后被触发
-        int rotation = ticks / N;
-        // 计算待插入的定时器应该被插入哪个槽中
-        int ts = (cur_slot + (ticks % N));
+        // 计算待插入的定时器在时间轮转动多少圈后被触发，以及它应该被插入哪个槽中
+        int rotation = 0;
+        int ts = 0;
+        place(ticks, rotation, ts);
         // 创建新的定时器，它在时间轮转动rotation圈之后被触发，且处于第ts槽中
-        tw_timer* timer = new tw_timer(rotation, ts);
+        timer_type* timer = new timer_type(rotation, ts);
+        stats.on_add();
         // 如果第ts个槽中尚无任何定时器，则把新建的定时器插入其中，并将该定时器设置为该槽头结点
         if(!slots[ts])
         {
-            printf("add timer, rotation is %d, ts is %d, cur_slot is %d\n", rotation, ts, cur_slot);
+            TIMER_LOG("add timer, rotation is %d, ts is %d, cur_slot is %d", rotation, ts, cur_slot);
             slots[ts] = timer;
         }
         // 否则，将定时器插入第ts个槽中
@@ -121,87 +130,233 @@ public:
         return timer;
     }
 
-    // 删除目标定时器timer
-    void del_timer(tw_timer* timer)
+    // 创建一个在此后第n次调用tick时到期的定时器，n小于1时按1处理。add_timer把定时值折合为滴答数，不在
+    // tick中调用时定时器实际要等ticks+1次tick；按绝对时间安排定时器的上层设施用这个函数直接指定次数
+    timer_type* add_timer_in_ticks(int n)
     {
-        if(!timer)
+        if(n < 1)
         {
-            return;
+            n = 1;
         }
-        int ts = timer->time_slot;
-        // slots[ts]是目标定时器所在槽的头结点。如果目标定时器就是该头结点，则需要重置第ts个槽的头结点
-        if(timer == slots[ts])
+        int rotation = 0;
+        int ts = 0;
+        place(ticking ? n : n - 1, rotation, ts);
+        timer_type* timer = new timer_type(rotation, ts);
+        stats.on_add();
+        link(timer);
+        return timer;
+    }
+
+    // 批量创建定时器：timeouts[i]是第i个定时器的定时值，创建出的定时器依次写入out[i]，调用者随后填写
+    // 它们的回调函数和用户数据。定时值小于0的位置写入nullptr。每个定时器直接按槽号挂到对应的槽上，
+    // 返回成功创建的定时器数目
+    int add_timers(const int* timeouts, int n, timer_type** out)
+    {
+        if(!timeouts || !out || n <= 0)
         {
-            slots[ts] = slots[ts]->next;
-            if(slots[ts])
-            {
-                slots[ts]->prev = nullptr;
-            }
-            delete timer;
+            return 0;
         }
-        else
+        int added = 0;
+        for(int i = 0; i < n; ++i)
         {
-            timer->prev->next = timer->next;
-            if(timer->next)
+            if(timeouts[i] < 0)
             {
-                timer->next->prev = timer->prev;
+                out[i] = nullptr;
+                continue;
             }
-            delete timer;
+            int ticks = timeouts[i] < SI ? 1 : timeouts[i] / SI;
+            int rotation = 0;
+            int ts = 0;
+            place(ticks, rotation, ts);
+            timer_type* timer = new timer_type(rotation, ts);
+            link(timer);
+            out[i] = timer;
+            ++added;
+        }
+        stats.on_add(added);
+        return added;
+    }
+
+    // 删除目标定时器timer
+    void del_timer(timer_type* timer)
+    {
+        // 回调函数为空的定时器正在执行它的一次性任务，已经离开槽，由tick负责销毁
+        if(!timer || !timer->cb_func)
+        {
+            return;
+        }
+        // 如果tick正准备访问的下一个定时器被回调函数删除，则让tick跳过它
+        if(timer == cursor)
+        {
+            cursor = timer->next;
+        }
+        stats.on_cancel();
+        timer_group<timer_type>::leave(timer);
+        unlink(timer);
+        delete timer;
+    }
+
+    // 删除组中的所有定时器。组链表直接给出了每个节点，每个节点都以O(1)的代价从所在的槽中摘除
+    void del_group(timer_group<timer_type>& group)
+    {
+        while(!group.empty())
+        {
+            del_timer(group.front());
         }
     }
 
     // SI时间到后，调用该函数，时间轮向前滚动一个槽的间隔
     void tick()
     {
+        timer_stats::tick_scope scope(stats);
         // 取得时间轮上当前槽的头结点
-        tw_timer* tmp = slots[cur_slot];
-        printf("current slot is %d\n", cur_slot);
+        timer_type* tmp = slots[cur_slot];
+        uint64_t visited = 0;       // 访问过的定时器数目，即当前槽的链表长度
+        TIMER_LOG("current slot is %d", cur_slot);
+        ticking = true;
         while(tmp)
         {
-            printf("tick the timer once\n");
+            TIMER_LOG("tick the timer once");
+            // 先记下下一个待访问的定时器，回调函数中删除它时del_timer会把cursor向后移动
+            cursor = tmp->next;
+            ++visited;
             // 如果定时器的rotation值大于0，则它在这一轮不起作用
             if(tmp->rotation > 0)
             {
                 --tmp->rotation;
-                tmp = tmp->next;
             }
-            // 否则，说明定时器已经到期，可以执行定时任务，然后删除该定时器
+            // 否则，说明定时器已经到期，可以执行定时任务
             else
             {
-                tmp->cb_func(tmp->user_data);
-                if(tmp == slots[cur_slot])
+                unlink(tmp);
+                // 周期定时器在执行任务之前就被重新放入period个滴答之后的槽中，节点原地复用。下次到期的滴答数
+                // 由本次到期的滴答数推算而来，与tick被调用的时刻无关，因此长期运行也不会漂移
+                if(tmp->period > 0)
                 {
-                    printf("delete header in cur_slot\n");
-                    slots[cur_slot] = tmp->next;
-                    delete tmp;
-                    if(slots[cur_slot])
-                    {
-                        slots[cur_slot]->prev = nullptr;
-                    }
-                    tmp = slots[cur_slot];
+                    int ticks = tmp->period < SI ? 1 : tmp->period / SI;
+                    place(ticks, tmp->rotation, tmp->time_slot);
+                    link(tmp);
+                    stats.on_fire(true);
+                    tmp->cb_func(tmp->user_data);
                 }
+                // 一次性定时器执行完任务后被删除
                 else
                 {
-                    tmp->prev->next = tmp->next;
-                    if(tmp->next)
-                    {
-                        tmp->next->prev = tmp->prev;
-                    }
-                    tw_timer* tmp2 = tmp->next;
+                    TIMER_LOG("delete timer in cur_slot");
+                    timer_group<timer_type>::leave(tmp);
+                    // 先清空回调函数再执行，回调函数中对它自己调用del_timer就成了空操作
+                    void (*cb)(T) = tmp->cb_func;
+                    tmp->cb_func = nullptr;
+                    stats.on_fire(false);
+                    cb(tmp->user_data);
                     delete tmp;
-                    tmp = tmp2;
                 }
             }
+            tmp = cursor;
         }
+        cursor = nullptr;
+        ticking = false;
+        stats.on_slot(visited);
         // 更新时间轮的当前槽，以反映时间轮的转动
-        cur_slot = ++cur_slot % N;
+        cur_slot = (cur_slot + 1) % N;
+    }
+
+    // 时间轮转动一周的时间（秒），定时值小于它的定时器不需要转圈
+    static int horizon()
+    {
+        return N * SI;
+    }
+
+    // 槽间隔SI（秒），即tick应当被调用的间隔
+    static int interval()
+    {
+        return SI;
+    }
+
+    // 运行统计的快照
+    timer_stats_snapshot get_stats() const
+    {
+        return stats.snapshot();
+    }
+
+private:
+    // 计算ticks个滴答之后到期的定时器的圈数和槽号。不在tick中时，下一次tick就会访问当前槽，距离下一次
+    // 访问第ts个槽的滴答数在0到N-1之间；tick正在处理当前槽时（周期定时器重新入队，或者回调函数添加
+    // 定时器），当前槽已经处理过了，这个滴答数在1到N之间，落在当前槽的定时器要少转一圈
+    void place(int ticks, int& rotation, int& ts) const
+    {
+        int first = ticking && ticks % N == 0 ? N : ticks % N;
+        rotation = (ticks - first) / N;
+        ts = (cur_slot + ticks) % N;
+    }
+
+    // 把定时器插入它的time_slot对应的槽的头部
+    void link(timer_type* timer)
+    {
+        int ts = timer->time_slot;
+        timer->prev = nullptr;
+        timer->next = slots[ts];
+        if(slots[ts])
+        {
+            slots[ts]->prev = timer;
+        }
+        slots[ts] = timer;
+    }
+
+    // 把定时器从它所在的槽中摘下
+    void unlink(timer_type* timer)
+    {
+        int ts = timer->time_slot;
+        // slots[ts]是目标定时器所在槽的头结点。如果目标定时器就是该头结点，则需要重置第ts个槽的头结点
+        if(timer == slots[ts])
+        {
+            slots[ts] = slots[ts]->next;
+            if(slots[ts])
+            {
+                slots[ts]->prev = nullptr;
+            }
+        }
+        else
+        {
+            timer->prev->next = timer->next;
+            if(timer->next)
+            {
+                timer->next->prev = timer->prev;
+            }
+        }
     }
 
 private:
     static const int N = 60;    // 时间轮上槽的数目
     static const int SI = 1;    // 每SI秒时间轮转动一次，即槽间隔为SI
-    tw_timer* slots[N];         // 时间轮的槽，其中每个元素指向一个定时器链表，链表无序
+    timer_type* slots[N];       // 时间轮的槽，其中每个元素指向一个定时器链表，链表无序
     int cur_slot;               // 时间轮的当前槽
+    timer_type* cursor;         // tick遍历当前槽时下一个要访问的定时器
+    bool ticking;               // tick是否正在处理当前槽
+    timer_stats stats;          // 运行统计
+};
+
+// 时间轮的统一适配接口
+template <typename T>
+struct timer_traits<time_wheel<T> >
+{
+    typedef tw_timer<T> timer_type;
+
+    static timer_type* add_timer(time_wheel<T>& wheel, int timeout, void (*cb)(T), T data)
+    {
+        timer_type* timer = wheel.add_timer(timeout);
+        if(timer)
+        {
+            timer->cb_func = cb;
+            timer->user_data = data;
+        }
+        return timer;
+    }
+
+    static void del_timer(time_wheel<T>& wheel, timer_type* timer)
+    {
+        wheel.del_timer(timer);
+    }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,277 @@
+/*
+    基于定时器引擎的C++20协程等待体。timer_scheduler包装任意一个提供了timer_traits特化的引擎，
+    引擎的用户数据类型必须是timer_waiter*：
+
+        time_heap<timer_waiter*> heap(64);
+        timer_scheduler<time_heap<timer_waiter*> > timers(heap);
+
+        co_await timers.sleep_for(std::chrono::seconds(3));           // 挂起3秒
+        auto r = co_await timers.with_timeout(read_op, std::chrono::seconds(5)); // 超时返回空
+
+    协程的恢复发生在引擎的tick函数中，调用者照常在心搏里调用heap.tick()即可。等待体本身存放在协程帧里，
+    引擎节点来自timer_pool，因此sleep_for在稳定状态下不产生任何堆分配，代价与直接注册回调相同。
+
+    with_timeout需要让被等待的操作和定时器赛跑，被等待的操作在一个辅助协程中执行，辅助协程的帧同样
+    从timer_pool分配。超时先到时调用者立即恢复，而辅助协程继续等待原操作完成后自行销毁，所以原操作
+    必须最终完成（例如socket被关闭时以错误结束），否则辅助协程帧会一直存活。
+*/
+
+#ifndef TIMER_AWAITABLE_HPP
+#define TIMER_AWAITABLE_HPP
+
+#include <chrono>
+#include <coroutine>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "timer_pool.hpp"
+#include "timer_traits.hpp"
+
+// 挂在引擎上的等待者，定时器到期时引擎以它为参数调用timer_waiter::fire
+struct timer_waiter
+{
+    void (*on_fire)(timer_waiter*);
+
+    static void fire(timer_waiter* waiter)
+    {
+        waiter->on_fire(waiter);
+    }
+};
+
+namespace timer_detail
+{
+    // 把chrono时长向上取整为引擎使用的秒数
+    template <typename Rep, typename Period>
+    int to_timeout(std::chrono::duration<Rep, Period> d)
+    {
+        auto secs = std::chrono::ceil<std::chrono::seconds>(d).count();
+        return secs < 0 ? 0 : static_cast<int>(secs);
+    }
+
+    // with_timeout的辅助协程：等待原操作完成，然后把结果交给仍在等待的调用者
+    template <typename Owner>
+    class race_task
+    {
+    public:
+        struct promise_type
+        {
+            Owner* owner = nullptr;
+
+            race_task get_return_object() { return race_task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { throw; }
+
+            static void* operator new(size_t size) { return timer_pool::allocate(size); }
+            static void operator delete(void* p, size_t size) { timer_pool::release(p, size); }
+        };
+
+        // 在协程体内取得自己的promise
+        struct get_promise
+        {
+            promise_type* promise;
+
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<promise_type> h) noexcept
+            {
+                promise = &h.promise();
+                return false;
+            }
+            promise_type& await_resume() const noexcept { return *promise; }
+        };
+
+        explicit race_task(std::coroutine_handle<promise_type> h) : handle(h) {}
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    template <typename Owner, typename Awaitable>
+    race_task<Owner> race(Awaitable op)
+    {
+        auto& promise = co_await typename race_task<Owner>::get_promise{};
+        if constexpr(std::is_void_v<typename Owner::op_result>)
+        {
+            co_await std::move(op);
+            if(promise.owner)
+            {
+                promise.owner->complete();
+            }
+        }
+        else
+        {
+            auto&& value = co_await std::move(op);
+            if(promise.owner)
+            {
+                promise.owner->complete(std::forward<decltype(value)>(value));
+            }
+        }
+    }
+}
+
+template <typename Engine>
+class timer_scheduler
+{
+public:
+    typedef timer_traits<Engine> traits;
+    typedef typename traits::timer_type timer_type;
+
+    // sleep_for返回的等待体
+    class sleep_awaiter : private timer_waiter
+    {
+    public:
+        sleep_awaiter(Engine& e, int t) : engine(e), timeout(t), timer(nullptr) {}
+        sleep_awaiter(const sleep_awaiter&) = delete;
+        sleep_awaiter& operator=(const sleep_awaiter&) = delete;
+
+        // 协程在等待期间被销毁时，取消尚未到期的定时器
+        ~sleep_awaiter()
+        {
+            if(timer)
+            {
+                traits::del_timer(engine, timer);
+            }
+        }
+
+        bool await_ready() const noexcept { return timeout <= 0; }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            waiting = h;
+            on_fire = &sleep_awaiter::resume;
+            timer = traits::add_timer(engine, timeout, &timer_waiter::fire, static_cast<timer_waiter*>(this));
+        }
+
+        void await_resume() const noexcept {}
+
+    private:
+        static void resume(timer_waiter* w)
+        {
+            sleep_awaiter* self = static_cast<sleep_awaiter*>(w);
+            self->timer = nullptr;
+            self->waiting.resume();
+        }
+
+        Engine& engine;
+        int timeout;
+        timer_type* timer;
+        std::coroutine_handle<> waiting;
+    };
+
+    // with_timeout返回的等待体，结果为std::optional<R>，R为void时结果为bool（true表示操作先完成）
+    template <typename Awaitable>
+    class timeout_awaiter : private timer_waiter
+    {
+    public:
+        typedef decltype(std::declval<Awaitable>().await_resume()) op_result;
+        typedef std::conditional_t<std::is_void_v<op_result>, bool,
+            std::optional<std::remove_cvref_t<op_result> > > result_type;
+
+        // 左值形式的操作被复制进等待体，右值被移动进来
+        template <typename Op>
+        timeout_awaiter(Engine& e, Op&& o, int t)
+            : engine(e), op(std::forward<Op>(o)), timeout(t), timer(nullptr), suspending(false), result() {}
+        timeout_awaiter(const timeout_awaiter&) = delete;
+        timeout_awaiter& operator=(const timeout_awaiter&) = delete;
+
+        ~timeout_awaiter()
+        {
+            if(timer)
+            {
+                traits::del_timer(engine, timer);
+            }
+            if(runner)
+            {
+                runner.promise().owner = nullptr;
+            }
+        }
+
+        bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            waiting = h;
+            on_fire = &timeout_awaiter::expire;
+            timer = traits::add_timer(engine, timeout, &timer_waiter::fire, static_cast<timer_waiter*>(this));
+            runner = timer_detail::race<timeout_awaiter>(std::move(op)).handle;
+            runner.promise().owner = this;
+            // 原操作可能在辅助协程启动时就同步完成，此时complete不会恢复调用者，由返回false直接继续执行
+            suspending = true;
+            std::coroutine_handle<> r = runner;
+            r.resume();
+            suspending = false;
+            return static_cast<bool>(runner);
+        }
+
+        result_type await_resume() { return std::move(result); }
+
+        // 由辅助协程在原操作完成时调用
+        template <typename... V>
+        void complete(V&&... value)
+        {
+            runner = nullptr;
+            if(timer)
+            {
+                traits::del_timer(engine, timer);
+                timer = nullptr;
+            }
+            if constexpr(std::is_void_v<op_result>)
+            {
+                result = true;
+            }
+            else
+            {
+                result.emplace(std::forward<V>(value)...);
+            }
+            if(!suspending)
+            {
+                waiting.resume();
+            }
+        }
+
+    private:
+        // 定时器先到期：让辅助协程与调用者脱钩后恢复调用者，结果保持为空
+        static void expire(timer_waiter* w)
+        {
+            timeout_awaiter* self = static_cast<timeout_awaiter*>(w);
+            self->timer = nullptr;
+            if(self->runner)
+            {
+                self->runner.promise().owner = nullptr;
+                self->runner = nullptr;
+            }
+            self->waiting.resume();
+        }
+
+        Engine& engine;
+        Awaitable op;
+        int timeout;
+        timer_type* timer;
+        bool suspending;
+        result_type result;
+        std::coroutine_handle<> waiting;
+        std::coroutine_handle<typename timer_detail::race_task<timeout_awaiter>::promise_type> runner;
+    };
+
+public:
+    explicit timer_scheduler(Engine& e) : engine(e) {}
+
+    // 挂起当前协程d时长，由引擎的tick函数恢复
+    template <typename Rep, typename Period>
+    sleep_awaiter sleep_for(std::chrono::duration<Rep, Period> d)
+    {
+        return sleep_awaiter(engine, timer_detail::to_timeout(d));
+    }
+
+    // 等待op，若d时长内未完成则以空结果恢复
+    template <typename Awaitable, typename Rep, typename Period>
+    timeout_awaiter<std::decay_t<Awaitable> > with_timeout(Awaitable&& op, std::chrono::duration<Rep, Period> d)
+    {
+        return timeout_awaiter<std::decay_t<Awaitable> >(engine, std::forward<Awaitable>(op), timer_detail::to_timeout(d));
+    }
+
+private:
+    Engine& engine;
+};
+
+#endif
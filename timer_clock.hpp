@@ -0,0 +1,97 @@
+/*
+    定时器引擎的时钟。各个引擎原本直接调用time(NULL)读取当前时间，测试一天的超时行为就要真的等一天。
+    现在引擎统一通过timer_now()读取当前时间：当前线程安装了虚拟时钟时返回虚拟时钟的时间，否则返回
+    time(NULL)。虚拟时钟只在调用advance或set时前进，可以在几秒内推进几个小时的时间。
+
+        virtual_clock clock(0);
+        virtual_clock::scope use(clock);     // 在scope的生存期内，本线程的引擎都使用clock
+        heap.add_timer(...);
+        clock.advance(3600);                  // 时间前进一小时
+        heap.tick();
+
+    安装关系记录在thread_local变量中，不同线程可以各自使用独立的虚拟时钟，互不影响。引擎本身与时钟
+    无关，同一个引擎的添加和tick应当在同一个时钟下进行。
+*/
+
+#ifndef TIMER_CLOCK_HPP
+#define TIMER_CLOCK_HPP
+
+#include <time.h>
+
+// 手动推进的虚拟时钟
+class virtual_clock
+{
+public:
+    // 在作用域内把虚拟时钟安装到当前线程，离开作用域时恢复之前安装的时钟，可以嵌套
+    class scope
+    {
+    public:
+        explicit scope(virtual_clock& clock) : prev(installed())
+        {
+            installed() = &clock;
+        }
+
+        ~scope()
+        {
+            installed() = prev;
+        }
+
+    private:
+        scope(const scope&);
+        scope& operator=(const scope&);
+
+        virtual_clock* prev;    // 之前安装的时钟
+    };
+
+    explicit virtual_clock(time_t start = 0) : cur(start) {}
+
+    time_t now() const
+    {
+        return cur;
+    }
+
+    // 时间前进seconds秒
+    void advance(time_t seconds)
+    {
+        cur += seconds;
+    }
+
+    // 把时间设为t，虚拟时钟允许回拨，由调用者保证引擎能够接受
+    void set(time_t t)
+    {
+        cur = t;
+    }
+
+    // 当前线程安装的虚拟时钟，没有安装时为nullptr
+    static virtual_clock*& installed()
+    {
+        static thread_local virtual_clock* clock = nullptr;
+        return clock;
+    }
+
+private:
+    time_t cur;     // 当前时间
+};
+
+// 引擎读取当前时间的唯一入口
+inline time_t timer_now()
+{
+    virtual_clock* clock = virtual_clock::installed();
+    return clock ? clock->now() : time(NULL);
+}
+
+// 计算周期定时器的下一次超时时间：expire加上一个周期。如果tick被耽搁了好几个周期，则跳过已经错过的
+// 周期而不是连续补发。新的超时时间由上一次的超时时间推算，仍然与最初的相位对齐，长期运行不会累积漂移。
+// Time可以是time_t，也可以是以滴答数计时的整数类型
+template <typename Time>
+inline Time timer_next_expire(Time expire, Time period, Time cur)
+{
+    expire += period;
+    if(expire <= cur)
+    {
+        expire += ((cur - expire) / period + 1) * period;
+    }
+    return expire;
+}
+
+#endif
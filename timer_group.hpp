@@ -0,0 +1,100 @@
+/*
+    定时器组：把属于同一个连接或租户的多个定时器（空闲超时、写超时、握手超时、重试等）串成一条侵入式
+    双向链表。连接销毁时调用引擎的del_group即可一次取消整组定时器，引擎沿着组链表直接摘除节点，不需要
+    逐个查找。
+
+    模板参数Timer是引擎的定时器节点类型，它需要提供group、group_prev、group_next三个成员。
+    一个定时器同一时刻最多属于一个组；一次性定时器到期或被删除时由引擎自动将其移出所在的组。
+*/
+
+#ifndef TIMER_GROUP_HPP
+#define TIMER_GROUP_HPP
+
+#include <stddef.h>
+
+template <typename Timer>
+class timer_group
+{
+public:
+    timer_group() : head(nullptr), count(0) {}
+
+    // 组被销毁时仍在组中的定时器只是与组脱钩，不会被取消
+    ~timer_group()
+    {
+        while(head)
+        {
+            leave(head);
+        }
+    }
+
+    // 把定时器加入本组，如果它已经属于其他组，则先离开原来的组
+    void join(Timer* timer)
+    {
+        if(!timer || timer->group == this)
+        {
+            return;
+        }
+        if(timer->group)
+        {
+            timer->group->leave(timer);
+        }
+        timer->group = this;
+        timer->group_prev = nullptr;
+        timer->group_next = head;
+        if(head)
+        {
+            head->group_prev = timer;
+        }
+        head = timer;
+        ++count;
+    }
+
+    // 把定时器移出它所在的组，定时器不属于任何组时什么也不做
+    static void leave(Timer* timer)
+    {
+        timer_group* group = timer->group;
+        if(!group)
+        {
+            return;
+        }
+        if(timer->group_prev)
+        {
+            timer->group_prev->group_next = timer->group_next;
+        }
+        else
+        {
+            group->head = timer->group_next;
+        }
+        if(timer->group_next)
+        {
+            timer->group_next->group_prev = timer->group_prev;
+        }
+        timer->group = nullptr;
+        timer->group_prev = timer->group_next = nullptr;
+        --group->count;
+    }
+
+    Timer* front() const
+    {
+        return head;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return !head;
+    }
+
+private:
+    timer_group(const timer_group&);
+    timer_group& operator=(const timer_group&);
+
+    Timer* head;    // 组链表的头节点
+    size_t count;   // 组中定时器的数目
+};
+
+#endif
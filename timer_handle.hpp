@@ -0,0 +1,262 @@
+/*
+    带代数校验的定时器句柄：各个引擎交给调用者的都是节点指针，一次性定时器到期后节点随即被销毁，调用者
+    手里的指针就悬空了，之后再调用del_timer或adjust_timer就是释放后使用。句柄由32位的下标和32位的代数
+    组成，下标指向一个连续的槽数组，槽每被回收一次代数就加1。使用句柄时先比较代数，到期或已删除的定时器
+    对应的句柄代数不再匹配，取消和调整都变成什么也不做的空操作，调用者不需要额外记录定时器是否已经到期。
+
+    handle_slots<V>是通用的槽数组，值类型时间堆用它管理记录的下标；handle_timer_mgr<Engine, T>则基于
+    timer_traits给任意一种引擎套上句柄接口。
+
+    从执行效率来看：
+        分配、查找、回收一个句柄的时间复杂度都是O(1)
+*/
+
+#ifndef TIMER_HANDLE_HPP
+#define TIMER_HANDLE_HPP
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+#include "timer_traits.hpp"
+
+// 定时器句柄，代数从1开始，全为0的句柄永远无效
+struct timer_handle
+{
+    uint32_t index;         // 槽数组的下标
+    uint32_t generation;    // 分配句柄时槽的代数
+
+    bool operator==(const timer_handle& other) const
+    {
+        return index == other.index && generation == other.generation;
+    }
+
+    bool operator!=(const timer_handle& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+const timer_handle INVALID_TIMER_HANDLE = { 0, 0 };
+
+// 以句柄为下标的槽数组，回收的槽串成空闲链表，之后优先复用
+template <typename V>
+class handle_slots
+{
+public:
+    handle_slots() : free_head(NONE), count(0) {}
+
+    // 分配一个槽存放value，返回指向它的句柄
+    timer_handle insert(const V& value)
+    {
+        uint32_t index;
+        if(free_head != NONE)
+        {
+            index = free_head;
+            free_head = slots[index].next_free;
+        }
+        else
+        {
+            index = static_cast<uint32_t>(slots.size());
+            slot s;
+            s.generation = 1;
+            slots.push_back(s);
+        }
+        slots[index].value = value;
+        slots[index].next_free = USED;
+        ++count;
+        timer_handle h = { index, slots[index].generation };
+        return h;
+    }
+
+    // 句柄有效时返回槽中的值，否则返回nullptr
+    V* get(timer_handle h)
+    {
+        if(h.index >= slots.size() || slots[h.index].generation != h.generation || slots[h.index].next_free != USED)
+        {
+            return nullptr;
+        }
+        return &slots[h.index].value;
+    }
+
+    const V* get(timer_handle h) const
+    {
+        return const_cast<handle_slots*>(this)->get(h);
+    }
+
+    // 不检查代数，直接按下标访问，调用者需保证该槽正在使用
+    V& at(uint32_t index)
+    {
+        return slots[index].value;
+    }
+
+    // 当前使用某个下标的句柄
+    timer_handle handle_of(uint32_t index) const
+    {
+        timer_handle h = { index, slots[index].generation };
+        return h;
+    }
+
+    // 回收句柄对应的槽，代数加1使所有指向它的旧句柄失效。句柄无效时返回false
+    bool erase(timer_handle h)
+    {
+        if(!get(h))
+        {
+            return false;
+        }
+        slot& s = slots[h.index];
+        if(++s.generation == 0)
+        {
+            s.generation = 1;
+        }
+        s.next_free = free_head;
+        free_head = h.index;
+        --count;
+        return true;
+    }
+
+    int size() const
+    {
+        return count;
+    }
+
+private:
+    static const uint32_t NONE = 0xffffffffu;   // 空闲链表的结尾
+    static const uint32_t USED = 0xfffffffeu;   // 槽正在使用
+
+    struct slot
+    {
+        V value;
+        uint32_t generation;    // 槽的代数
+        uint32_t next_free;     // 空闲链表中的下一个槽，正在使用时为USED
+    };
+
+    std::vector<slot> slots;    // 槽数组
+    uint32_t free_head;         // 空闲链表的头
+    int count;                  // 正在使用的槽数
+};
+
+// 基于timer_traits的句柄接口：Engine是引擎模板（如time_heap），T是用户数据类型。引擎中的节点
+// 只携带一个指回本对象和槽下标的小结构，回调函数和用户数据保存在槽中
+template <template <typename> class Engine, typename T>
+class handle_timer_mgr
+{
+public:
+    // 引擎节点携带的数据
+    struct slot_ref
+    {
+        handle_timer_mgr* mgr;
+        uint32_t index;
+    };
+
+    typedef Engine<slot_ref> engine_type;
+    typedef typename timer_traits<engine_type>::timer_type node_type;
+
+    // 构造参数原样转发给引擎，例如时间堆的初始容量
+    template <typename... Args>
+    explicit handle_timer_mgr(Args&&... args) : engine(std::forward<Args>(args)...) {}
+
+    // 添加一个timeout秒后到期的定时器，period大于0时为周期定时器。引擎拒绝添加（如时间轮遇到负的
+    // 超时值）时返回INVALID_TIMER_HANDLE
+    timer_handle add_timer(int timeout, void (*cb)(T), T data, int period = 0)
+    {
+        record r;
+        r.node = nullptr;
+        r.cb_func = cb;
+        r.user_data = data;
+        timer_handle h = records.insert(r);
+        slot_ref ref = { this, h.index };
+        node_type* node = timer_traits<engine_type>::add_timer(engine, timeout, &handle_timer_mgr::fire, ref);
+        if(!node)
+        {
+            records.erase(h);
+            return INVALID_TIMER_HANDLE;
+        }
+        node->period = period;
+        records.at(h.index).node = node;
+        return h;
+    }
+
+    // 取消定时器，定时器已经到期或被删除时什么也不做
+    void del_timer(timer_handle h)
+    {
+        record* r = records.get(h);
+        if(!r)
+        {
+            return;
+        }
+        node_type* node = r->node;
+        records.erase(h);
+        timer_traits<engine_type>::del_timer(engine, node);
+    }
+
+    // 把定时器改为timeout秒后到期，周期不变。定时器已经到期或被删除时返回false；引擎拒绝新的超时值时
+    // 原来的定时器已经取消，句柄随之失效，同样返回false
+    bool adjust_timer(timer_handle h, int timeout)
+    {
+        record* r = records.get(h);
+        if(!r)
+        {
+            return false;
+        }
+        int period = r->node->period;
+        timer_traits<engine_type>::del_timer(engine, r->node);
+        slot_ref ref = { this, h.index };
+        node_type* node = timer_traits<engine_type>::add_timer(engine, timeout, &handle_timer_mgr::fire, ref);
+        if(!node)
+        {
+            records.erase(h);
+            return false;
+        }
+        node->period = period;
+        records.at(h.index).node = node;
+        return true;
+    }
+
+    // 句柄是否仍然指向一个尚未到期的定时器
+    bool valid(timer_handle h) const
+    {
+        return records.get(h) != nullptr;
+    }
+
+    int size() const
+    {
+        return records.size();
+    }
+
+    void tick()
+    {
+        engine.tick();
+    }
+
+    engine_type& get_engine()
+    {
+        return engine;
+    }
+
+private:
+    struct record
+    {
+        node_type* node;        // 定时器在引擎中的节点
+        void (*cb_func)(T);     // 定时器回调函数
+        T user_data;            // 用户数据
+    };
+
+    // 引擎中的节点到期。一次性定时器先回收句柄再执行任务，回调函数中对自身句柄的操作都是空操作；
+    // 周期定时器的节点由引擎重新安排，句柄保持有效
+    static void fire(slot_ref ref)
+    {
+        handle_timer_mgr* self = ref.mgr;
+        record r = self->records.at(ref.index);
+        if(r.node->period <= 0)
+        {
+            self->records.erase(self->records.handle_of(ref.index));
+        }
+        r.cb_func(r.user_data);
+    }
+
+private:
+    engine_type engine;                 // 实际存放定时器的引擎
+    handle_slots<record> records;       // 句柄对应的回调函数、用户数据和引擎节点
+};
+
+#endif
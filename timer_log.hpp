@@ -0,0 +1,221 @@
+/*
+    定时器引擎的调试日志：引擎中的跟踪输出统一写成TIMER_LOG(format, ...)，参数与printf相同，GCC和Clang
+    会像检查printf一样检查格式串与参数。
+
+    发布版本（定义了NDEBUG，或者定义了TIMER_NO_LOG）中TIMER_LOG展开为空语句，参数不会被求值，没有任何开销。
+    调试版本默认与原来的printf相同，把每条消息直接写到标准输出。
+
+    在tick的热路径上做I/O会明显拖慢调试版本，此时可以定义TIMER_LOG_RING：TIMER_LOG改为把格式化后的消息
+    写入当前线程的环形缓冲区，不做任何I/O；缓冲区写满时丢弃新消息并计数。消息由timer_log::drain写到文件，
+    可以在任意时刻手动调用，也可以创建一个timer_log_drainer，由它的后台线程定期写出：
+
+        timer_log_drainer drainer(stderr);   // 每10毫秒把所有线程的日志写到stderr
+
+    每个线程的环形缓冲区只有一个生产者（所属线程）和一个消费者（持有注册表锁的drain），读写位置用
+    acquire/release同步，生产者写日志时不需要加锁。只有定义了TIMER_LOG_RING才会引入<thread>和<mutex>，
+    这时需要以-pthread编译。
+*/
+
+#ifndef TIMER_LOG_HPP
+#define TIMER_LOG_HPP
+
+#if defined(NDEBUG) || defined(TIMER_NO_LOG)
+
+#define TIMER_LOG(...) ((void)0)
+
+#else
+
+// 让编译器按printf检查格式串，第1个参数是格式串，可变参数从第2个开始
+#if defined(__GNUC__)
+#define TIMER_LOG_PRINTF __attribute__((format(printf, 1, 2)))
+#else
+#define TIMER_LOG_PRINTF
+#endif
+
+#ifndef TIMER_LOG_RING
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#define TIMER_LOG(...) timer_log_print(__VA_ARGS__)
+
+// 把一条消息直接写到标准输出
+inline void timer_log_print(const char* format, ...) TIMER_LOG_PRINTF;
+
+inline void timer_log_print(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    putchar('\n');
+}
+
+#else
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define TIMER_LOG(...) timer_log::write(__VA_ARGS__)
+
+// 单生产者单消费者的日志环形缓冲区
+class timer_log_ring
+{
+public:
+    static const size_t CAPACITY = 1024;    // 缓冲区能容纳的消息条数，必须是2的幂
+    static const size_t MESSAGE = 120;      // 每条消息的最大长度，超出的部分被截断
+
+    timer_log_ring() : head(0), tail(0), dropped(0) {}
+
+    // 由所属线程调用，缓冲区已满时丢弃这条消息
+    void push(const char* format, va_list args)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if(h - tail.load(std::memory_order_acquire) >= CAPACITY)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        vsnprintf(slots[h & (CAPACITY - 1)], MESSAGE, format, args);
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // 由消费者调用，把缓冲区中的消息逐行写到out，返回写出的条数
+    size_t pop_all(FILE* out)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t h = head.load(std::memory_order_acquire);
+        for(size_t i = t; i != h; ++i)
+        {
+            fputs(slots[i & (CAPACITY - 1)], out);
+            fputc('\n', out);
+        }
+        tail.store(h, std::memory_order_release);
+        size_t lost = dropped.exchange(0, std::memory_order_relaxed);
+        if(lost)
+        {
+            fprintf(out, "timer_log: %zu messages dropped\n", lost);
+        }
+        return h - t;
+    }
+
+private:
+    char slots[CAPACITY][MESSAGE];      // 消息
+    std::atomic<size_t> head;           // 下一条消息写入的位置，只由生产者修改
+    std::atomic<size_t> tail;           // 下一条消息读出的位置，只由消费者修改
+    std::atomic<size_t> dropped;        // 缓冲区满时丢弃的消息数
+};
+
+// 所有线程的日志缓冲区的注册表
+class timer_log
+{
+public:
+    // 写一条日志到当前线程的缓冲区
+    static void write(const char* format, ...) TIMER_LOG_PRINTF
+    {
+        va_list args;
+        va_start(args, format);
+        local().ring.push(format, args);
+        va_end(args);
+    }
+
+    // 把所有线程缓冲区中的消息写到out，返回写出的条数
+    static size_t drain(FILE* out)
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        size_t n = 0;
+        for(size_t i = 0; i < registry().rings.size(); ++i)
+        {
+            n += registry().rings[i]->pop_all(out);
+        }
+        if(n)
+        {
+            fflush(out);
+        }
+        return n;
+    }
+
+private:
+    struct registry_type
+    {
+        std::mutex mutex;
+        std::vector<timer_log_ring*> rings;
+    };
+
+    // 线程第一次写日志时注册自己的缓冲区，退出时摘下，尚未写出的消息随之丢弃
+    struct local_ring
+    {
+        local_ring()
+        {
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            registry().rings.push_back(&ring);
+        }
+
+        ~local_ring()
+        {
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            std::vector<timer_log_ring*>& rings = registry().rings;
+            rings.erase(std::remove(rings.begin(), rings.end(), &ring), rings.end());
+        }
+
+        timer_log_ring ring;
+    };
+
+    static registry_type& registry()
+    {
+        static registry_type r;
+        return r;
+    }
+
+    static local_ring& local()
+    {
+        static thread_local local_ring r;
+        return r;
+    }
+};
+
+// 后台线程定期调用timer_log::drain，析构时停止线程并写出剩下的消息
+class timer_log_drainer
+{
+public:
+    explicit timer_log_drainer(FILE* out, int interval_ms = 10)
+        : out(out), interval(interval_ms), running(true), worker(&timer_log_drainer::run, this) {}
+
+    ~timer_log_drainer()
+    {
+        running.store(false, std::memory_order_relaxed);
+        worker.join();
+        timer_log::drain(out);
+    }
+
+private:
+    timer_log_drainer(const timer_log_drainer&);
+    timer_log_drainer& operator=(const timer_log_drainer&);
+
+    void run()
+    {
+        while(running.load(std::memory_order_relaxed))
+        {
+            timer_log::drain(out);
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+        }
+    }
+
+    FILE* out;                  // 日志写到这里
+    int interval;               // 两次写出之间的间隔（毫秒）
+    std::atomic<bool> running;  // 后台线程是否继续运行
+    std::thread worker;         // 后台线程
+};
+
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,103 @@
+/*
+    定时器节点内存池：按16字节对齐划分尺寸等级，每个等级维护一条线程本地的空闲链表。
+    空闲链表为空时一次性切出一整块slab，之后的分配和释放只是链表头的弹出和压入，
+    不再进入malloc。定时器节点和协程帧的大小是固定的几种，非常适合这种分配方式。
+
+    注意：slab一旦切出就不再归还给系统，池的内存占用等于历史上同时存活节点数的峰值。
+
+    定义宏TIMER_HUGE_PAGES后，slab的大小改为一个2MB的大页，由huge_page分配，千万级的节点只占用
+    数千个页表项。
+*/
+
+#ifndef TIMER_POOL_HPP
+#define TIMER_POOL_HPP
+
+#include <stddef.h>
+#include <new>
+#ifdef TIMER_HUGE_PAGES
+#include "huge_page.hpp"
+#endif
+
+class timer_pool
+{
+public:
+    // 分配size字节，超过MAX_SIZE的请求直接交给全局operator new
+    static void* allocate(size_t size)
+    {
+        if(size == 0 || size > MAX_SIZE)
+        {
+            return ::operator new(size);
+        }
+        free_node*& head = free_list(size_class(size));
+        if(!head)
+        {
+            refill(head, (size_class(size)+1)*ALIGN);
+        }
+        free_node* node = head;
+        head = node->next;
+        return node;
+    }
+
+    // 释放由allocate分配的内存，size必须与分配时一致
+    static void release(void* p, size_t size)
+    {
+        if(!p)
+        {
+            return;
+        }
+        if(size == 0 || size > MAX_SIZE)
+        {
+            ::operator delete(p);
+            return;
+        }
+        free_node*& head = free_list(size_class(size));
+        free_node* node = static_cast<free_node*>(p);
+        node->next = head;
+        head = node;
+    }
+
+private:
+    struct free_node
+    {
+        free_node* next;
+    };
+
+    static const size_t ALIGN = 16;                 // 尺寸等级的粒度
+    static const size_t MAX_SIZE = 1024;            // 由内存池管理的最大块
+    static const size_t CLASSES = MAX_SIZE / ALIGN; // 尺寸等级的数目
+#ifdef TIMER_HUGE_PAGES
+    static const size_t SLAB_SIZE = huge_page::SIZE; // 每次向系统申请的slab大小
+#else
+    static const size_t SLAB_SIZE = 64 * 1024;      // 每次向系统申请的slab大小
+#endif
+
+    static size_t size_class(size_t size)
+    {
+        return (size - 1) / ALIGN;
+    }
+
+    static free_node*& free_list(size_t cls)
+    {
+        static thread_local free_node* lists[CLASSES] = {};
+        return lists[cls];
+    }
+
+    // 切出一块slab，把它分成大小为block的小块串到空闲链表上
+    static void refill(free_node*& head, size_t block)
+    {
+#ifdef TIMER_HUGE_PAGES
+        char* slab = static_cast<char*>(huge_page::allocate(SLAB_SIZE));
+#else
+        char* slab = static_cast<char*>(::operator new(SLAB_SIZE));
+#endif
+        size_t count = SLAB_SIZE / block;
+        for(size_t i = 0; i < count; ++i)
+        {
+            free_node* node = reinterpret_cast<free_node*>(slab + i*block);
+            node->next = head;
+            head = node;
+        }
+    }
+};
+
+#endif
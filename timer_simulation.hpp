@@ -0,0 +1,237 @@
+/*
+    长时间跨度的定时器模拟：在虚拟时钟（见timer_clock.hpp）下逐秒推进，模拟连接的建立、活动和关闭，
+    几秒钟内跑完几个小时的连接流量，统计引擎的到期开销和内存占用。
+
+    每个模拟连接持有一个空闲超时定时器：
+        每秒新建arrivals个连接，每个连接添加一个idle_timeout秒的定时器；
+        连接每隔平均active_gap秒活动一次，活动时取消旧定时器并重新添加，即重置空闲超时；
+        连接的存活时长平均为lifetime秒，到时主动关闭并取消定时器；
+        定时器先于活动和关闭到期时，连接因空闲超时被关闭。
+    间隔和存活时长服从指数分布，截断到EVENT_HORIZON秒以内。
+
+    引擎通过timer_traits驱动，用户数据类型必须是sim_connection*，与timer_awaitable.hpp对引擎的要求相同：
+
+        time_heap<sim_connection*> heap(64);
+        sim_config cfg;                       // 默认模拟一小时
+        sim_report r = simulate(heap, cfg);
+
+    模拟期间当前线程安装一个从cfg.start开始的虚拟时钟，每模拟一秒调用一次引擎的tick。所有引擎都应当
+    按秒调用tick，时间轮的槽间隔SI也是1秒。tick的耗时用steady_clock测量，内存占用取进程的峰值常驻内存。
+*/
+
+#ifndef TIMER_SIMULATION_HPP
+#define TIMER_SIMULATION_HPP
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <chrono>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+#include "timer_clock.hpp"
+#include "timer_traits.hpp"
+
+// 模拟参数
+struct sim_config
+{
+    int duration;           // 模拟时长（秒）
+    int arrivals;           // 每秒新建的连接数
+    int idle_timeout;       // 空闲超时（秒）
+    int active_gap;         // 连接两次活动之间的平均间隔（秒）
+    int lifetime;           // 连接的平均存活时长（秒）
+    time_t start;           // 虚拟时钟的起始时间
+    uint32_t seed;          // 随机数种子，相同的参数和种子产生相同的流量
+
+    sim_config()
+        : duration(3600), arrivals(100), idle_timeout(30), active_gap(20), lifetime(600), start(0), seed(1) {}
+};
+
+// 模拟结果
+struct sim_report
+{
+    long long adds;             // 添加的定时器数目，包括活动时重置的定时器
+    long long cancels;          // 取消的定时器数目
+    long long fires;            // 到期的定时器数目，即因空闲超时关闭的连接数
+    long long closes;           // 主动关闭的连接数
+    int peak_live;              // 同时存活的定时器数目的峰值
+    double tick_seconds;        // 所有tick的总耗时（秒）
+    double max_tick_seconds;    // 单次tick的最大耗时（秒）
+    double wall_seconds;        // 整个模拟的耗时（秒）
+    long peak_rss_kb;           // 模拟结束时进程的峰值常驻内存（KB），不支持时为0
+};
+
+// 模拟连接
+struct sim_connection
+{
+    void* timer;                // 当前的空闲超时定时器，为nullptr表示连接已经因超时关闭
+    time_t close_at;            // 主动关闭的时间
+};
+
+namespace sim_detail
+{
+    // xorshift32随机数发生器，保证不同平台上的流量相同
+    class random
+    {
+    public:
+        explicit random(uint32_t seed) : state(seed ? seed : 1) {}
+
+        uint32_t next()
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        }
+
+        // 均值为mean秒的指数分布，取整后截断到[1, limit]
+        int exponential(int mean, int limit)
+        {
+            double u = (next() >> 8) * (1.0 / 16777216.0);
+            double v = -log(1.0 - u) * mean;
+            return v < 1 ? 1 : (v > limit ? limit : static_cast<int>(v));
+        }
+
+    private:
+        uint32_t state;
+    };
+
+    // 进程的峰值常驻内存（KB）
+    inline long peak_rss_kb()
+    {
+#if defined(__APPLE__)
+        struct rusage usage;
+        return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss / 1024 : 0;
+#elif defined(__unix__)
+        struct rusage usage;
+        return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+#else
+        return 0;
+#endif
+    }
+
+    // 时刻t在n个桶的事件环中对应的桶，t不早于start
+    inline size_t slot(time_t t, time_t start, int n)
+    {
+        return static_cast<size_t>(t - start) % static_cast<size_t>(n);
+    }
+}
+
+// 在虚拟时钟下用cfg描述的连接流量驱动引擎engine，返回统计结果
+template <typename Engine>
+sim_report simulate(Engine& engine, const sim_config& cfg)
+{
+    typedef timer_traits<Engine> traits;
+    typedef typename traits::timer_type timer_type;
+    typedef std::chrono::steady_clock steady;
+
+    static const int EVENT_HORIZON = 4096;  // 活动和关闭事件最多安排在多少秒之后
+
+    // 定时器到期的回调函数，把连接标记为已关闭，连接本身在它的下一个事件被处理时释放
+    struct on_idle
+    {
+        static long long& fires()
+        {
+            static thread_local long long n = 0;
+            return n;
+        }
+
+        static void run(sim_connection* conn)
+        {
+            conn->timer = nullptr;
+            ++fires();
+        }
+    };
+
+    sim_report report = sim_report();
+    sim_detail::random rnd(cfg.seed);
+    virtual_clock clock(cfg.start);
+    virtual_clock::scope use(clock);
+    on_idle::fires() = 0;
+
+    // 事件环：第(t - cfg.start) % EVENT_HORIZON个桶中是下一个事件（活动或关闭）发生在第t秒的连接。
+    // 事件都不早于cfg.start，按相对于它的偏移取模，cfg.start为负数时下标也不会是负数
+    std::vector<std::vector<sim_connection*> > events(EVENT_HORIZON);
+    long long live = 0;
+    steady::time_point begin = steady::now();
+
+    for(int sec = 0; sec < cfg.duration; ++sec)
+    {
+        time_t now = clock.now();
+
+        // 处理本秒的活动和关闭事件
+        std::vector<sim_connection*> due;
+        due.swap(events[sim_detail::slot(now, cfg.start, EVENT_HORIZON)]);
+        for(size_t i = 0; i < due.size(); ++i)
+        {
+            sim_connection* conn = due[i];
+            if(!conn->timer)
+            {
+                // 已经因空闲超时关闭
+                delete conn;
+                continue;
+            }
+            traits::del_timer(engine, static_cast<timer_type*>(conn->timer));
+            ++report.cancels;
+            if(now >= conn->close_at)
+            {
+                --live;
+                ++report.closes;
+                delete conn;
+                continue;
+            }
+            conn->timer = traits::add_timer(engine, cfg.idle_timeout, &on_idle::run, conn);
+            ++report.adds;
+            int gap = rnd.exponential(cfg.active_gap, EVENT_HORIZON - 1);
+            time_t next = now + gap < conn->close_at ? now + gap : conn->close_at;
+            events[sim_detail::slot(next, cfg.start, EVENT_HORIZON)].push_back(conn);
+        }
+
+        // 新建本秒的连接
+        for(int i = 0; i < cfg.arrivals; ++i)
+        {
+            sim_connection* conn = new sim_connection;
+            conn->close_at = now + rnd.exponential(cfg.lifetime, EVENT_HORIZON - 1);
+            conn->timer = traits::add_timer(engine, cfg.idle_timeout, &on_idle::run, conn);
+            ++report.adds;
+            ++live;
+            int gap = rnd.exponential(cfg.active_gap, EVENT_HORIZON - 1);
+            time_t next = now + gap < conn->close_at ? now + gap : conn->close_at;
+            events[sim_detail::slot(next, cfg.start, EVENT_HORIZON)].push_back(conn);
+        }
+
+        // 时间前进一秒，执行到期的定时器
+        clock.advance(1);
+        long long fired = on_idle::fires();
+        steady::time_point t0 = steady::now();
+        engine.tick();
+        double cost = std::chrono::duration<double>(steady::now() - t0).count();
+        live -= on_idle::fires() - fired;
+        report.tick_seconds += cost;
+        report.max_tick_seconds = cost > report.max_tick_seconds ? cost : report.max_tick_seconds;
+        report.peak_live = live > report.peak_live ? static_cast<int>(live) : report.peak_live;
+    }
+
+    report.wall_seconds = std::chrono::duration<double>(steady::now() - begin).count();
+    report.fires = on_idle::fires();
+    report.peak_rss_kb = sim_detail::peak_rss_kb();
+
+    // 取消仍然存活的定时器并释放所有连接
+    for(size_t b = 0; b < events.size(); ++b)
+    {
+        for(size_t i = 0; i < events[b].size(); ++i)
+        {
+            sim_connection* conn = events[b][i];
+            if(conn->timer)
+            {
+                traits::del_timer(engine, static_cast<timer_type*>(conn->timer));
+            }
+            delete conn;
+        }
+    }
+    return report;
+}
+
+#endif
@@ -0,0 +1,211 @@
+/*
+    定时器引擎的运行统计：每个引擎内嵌一个timer_stats，在添加、取消、到期和tick时更新计数，调用者通过
+    引擎的get_stats()取得一份timer_stats_snapshot，据此发现定时器泄漏、延迟销毁堆积、槽链表过长或者
+    单次tick执行了太多回调函数等异常情况。
+
+    引擎本身不是线程安全的，只由所属的线程修改，所以计数器只有一个写者。计数器是std::atomic，写者用
+    relaxed的load和store更新，编译出来就是普通的读写，没有lock前缀的原子指令；监控线程可以随时用
+    relaxed的load读取快照，各个计数器之间不保证是同一时刻的值。
+
+    tick的耗时用steady_clock测量，每次tick读两次时钟。定义宏TIMER_NO_STATS后所有统计操作都为空。
+*/
+
+#ifndef TIMER_STATS_HPP
+#define TIMER_STATS_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+// 统计快照
+struct timer_stats_snapshot
+{
+    uint64_t adds;                  // 添加的定时器数目
+    uint64_t cancels;               // 取消的定时器数目
+    uint64_t fires;                 // 执行的回调函数数目，周期定时器每次到期计一次
+    uint64_t ticks;                 // tick的调用次数
+    int64_t live;                   // 尚未到期、也没有被取消的定时器数目
+    int64_t tombstones;             // 已经取消但仍留在引擎中等待延迟销毁的定时器数目
+    uint64_t max_slot_len;          // tick访问过的槽中最长的链表长度，不分槽的引擎为0
+    uint64_t max_fires_per_tick;    // 单次tick执行的回调函数的最大数目
+    uint64_t tick_ns_total;         // 所有tick的总耗时（纳秒）
+    uint64_t tick_ns_max;           // 单次tick的最大耗时（纳秒）
+};
+
+// 单写者的统计计数器
+class timer_stats
+{
+public:
+    // 在tick的作用域内测量耗时和执行的回调函数数目
+    class tick_scope
+    {
+    public:
+        explicit tick_scope(timer_stats& stats)
+#ifndef TIMER_NO_STATS
+            : stats(stats), fires(stats.fires.load(std::memory_order_relaxed)), start(std::chrono::steady_clock::now())
+#endif
+        {
+            (void)stats;
+        }
+
+        ~tick_scope()
+        {
+#ifndef TIMER_NO_STATS
+            uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+            bump(stats.ticks, 1);
+            bump(stats.tick_ns_total, ns);
+            raise(stats.tick_ns_max, ns);
+            raise(stats.max_fires_per_tick, stats.fires.load(std::memory_order_relaxed) - fires);
+#endif
+        }
+
+    private:
+        tick_scope(const tick_scope&);
+        tick_scope& operator=(const tick_scope&);
+
+#ifndef TIMER_NO_STATS
+        timer_stats& stats;
+        uint64_t fires;                                     // tick开始时已经执行的回调函数数目
+        std::chrono::steady_clock::time_point start;        // tick开始的时间
+#endif
+    };
+
+    timer_stats()
+    {
+        timer_stats_snapshot zero = timer_stats_snapshot();
+        assign(zero);
+    }
+
+    // 引擎被复制时统计也一并复制
+    timer_stats(const timer_stats& other)
+    {
+        assign(other.snapshot());
+    }
+
+    timer_stats& operator=(const timer_stats& other)
+    {
+        assign(other.snapshot());
+        return *this;
+    }
+
+    // 添加了n个定时器
+    void on_add(int n = 1)
+    {
+        bump(adds, n);
+        bump(live, n);
+    }
+
+    // 从from所属的引擎接收了n个尚未到期的定时器（如配对堆的meld）。它们的添加随定时器一起转到这里，
+    // 两边各自满足adds - cancels - fires == live，所有引擎的统计之和保持不变
+    void on_transfer(timer_stats& from, int n)
+    {
+        bump(from.adds, -static_cast<int64_t>(n));
+        bump(from.live, -n);
+        on_add(n);
+    }
+
+    // 取消了一个尚未到期的定时器
+    void on_cancel()
+    {
+        bump(cancels, 1);
+        bump(live, -1);
+    }
+
+    // 执行了一个定时器的回调函数，一次性定时器随之结束
+    void on_fire(bool periodic)
+    {
+        bump(fires, 1);
+        if(!periodic)
+        {
+            bump(live, -1);
+        }
+    }
+
+    // 引擎中等待延迟销毁的定时器数目变为n
+    void set_tombstones(int n)
+    {
+#ifndef TIMER_NO_STATS
+        tombstones.store(n, std::memory_order_relaxed);
+#else
+        (void)n;
+#endif
+    }
+
+    // tick访问了一个长度为len的槽
+    void on_slot(uint64_t len)
+    {
+        raise(max_slot_len, len);
+    }
+
+    timer_stats_snapshot snapshot() const
+    {
+        timer_stats_snapshot s;
+        s.adds = adds.load(std::memory_order_relaxed);
+        s.cancels = cancels.load(std::memory_order_relaxed);
+        s.fires = fires.load(std::memory_order_relaxed);
+        s.ticks = ticks.load(std::memory_order_relaxed);
+        s.live = live.load(std::memory_order_relaxed);
+        s.tombstones = tombstones.load(std::memory_order_relaxed);
+        s.max_slot_len = max_slot_len.load(std::memory_order_relaxed);
+        s.max_fires_per_tick = max_fires_per_tick.load(std::memory_order_relaxed);
+        s.tick_ns_total = tick_ns_total.load(std::memory_order_relaxed);
+        s.tick_ns_max = tick_ns_max.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    // 只有一个写者，读出、加上n、写回即可，不需要原子的读-改-写指令
+    template <typename V, typename N>
+    static void bump(std::atomic<V>& counter, N n)
+    {
+#ifndef TIMER_NO_STATS
+        counter.store(counter.load(std::memory_order_relaxed) + static_cast<V>(n), std::memory_order_relaxed);
+#else
+        (void)counter;
+        (void)n;
+#endif
+    }
+
+    // 记录最大值
+    static void raise(std::atomic<uint64_t>& counter, uint64_t value)
+    {
+#ifndef TIMER_NO_STATS
+        if(value > counter.load(std::memory_order_relaxed))
+        {
+            counter.store(value, std::memory_order_relaxed);
+        }
+#else
+        (void)counter;
+        (void)value;
+#endif
+    }
+
+    void assign(const timer_stats_snapshot& s)
+    {
+        adds.store(s.adds, std::memory_order_relaxed);
+        cancels.store(s.cancels, std::memory_order_relaxed);
+        fires.store(s.fires, std::memory_order_relaxed);
+        ticks.store(s.ticks, std::memory_order_relaxed);
+        live.store(s.live, std::memory_order_relaxed);
+        tombstones.store(s.tombstones, std::memory_order_relaxed);
+        max_slot_len.store(s.max_slot_len, std::memory_order_relaxed);
+        max_fires_per_tick.store(s.max_fires_per_tick, std::memory_order_relaxed);
+        tick_ns_total.store(s.tick_ns_total, std::memory_order_relaxed);
+        tick_ns_max.store(s.tick_ns_max, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> adds;
+    std::atomic<uint64_t> cancels;
+    std::atomic<uint64_t> fires;
+    std::atomic<uint64_t> ticks;
+    std::atomic<int64_t> live;
+    std::atomic<int64_t> tombstones;
+    std::atomic<uint64_t> max_slot_len;
+    std::atomic<uint64_t> max_fires_per_tick;
+    std::atomic<uint64_t> tick_ns_total;
+    std::atomic<uint64_t> tick_ns_max;
+};
+
+#endif
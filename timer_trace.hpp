@@ -0,0 +1,449 @@
+/*
+    定时器操作的录制与回放：在线上用timer_recorder包装引擎，把添加、取消、调整、到期和tick操作写成
+    紧凑的二进制轨迹；线下用replay_trace把同一份轨迹灌进任意一种引擎，比较引擎改动在真实流量下的吞吐量
+    和延迟，而不是只看合成的测试数据。
+
+    轨迹文件由16字节的文件头和若干条16字节的记录组成，按本机字节序存放：
+        文件头：魔数"TMTR"、版本号、录制开始时的timer_now()
+        记录：  相对开始时间的秒数、定时器编号、相对开始时间的到期秒数、低8位的操作类型和高24位的周期
+    定时器编号由录制器按添加顺序从0开始分配，一条轨迹中的编号不会重复使用，周期定时器每次到期都记录一条
+    FIRE。时间以秒为单位，与引擎的超时值一致，同一秒内的操作按记录的先后回放。
+
+        FILE* f = fopen("timers.trace", "wb");
+        timer_recorder<time_heap, int> timers(f, 64);       // 引擎的构造参数跟在文件后面
+        timer_handle h = timers.add_timer(15, on_idle, fd); // 15秒后以连接的文件描述符调用on_idle
+        timers.tick();
+
+    回放时当前线程安装虚拟时钟，在每条记录之前把时钟拨到记录的时间，因此几个小时的轨迹可以在几秒内回放
+    完毕。引擎通过timer_traits驱动，用户数据类型必须是trace_timer*：
+
+        time_wheel<trace_timer*> wheel;
+        trace_report r = replay_trace(wheel, fopen("timers.trace", "rb"));
+
+    每个操作的耗时用steady_clock测量，按2的幂分桶统计，报告中的分位数是所在桶的上界。
+*/
+
+#ifndef TIMER_TRACE_HPP
+#define TIMER_TRACE_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <deque>
+#include <utility>
+#include <vector>
+#include "timer_clock.hpp"
+#include "timer_handle.hpp"
+#include "timer_traits.hpp"
+
+// 轨迹中的操作类型
+enum trace_op
+{
+    TRACE_ADD = 1,          // 添加定时器
+    TRACE_CANCEL = 2,       // 取消定时器
+    TRACE_ADJUST = 3,       // 调整定时器的到期时间
+    TRACE_FIRE = 4,         // 定时器到期，回放时只用于核对
+    TRACE_TICK = 5          // 调用引擎的tick
+};
+
+const uint32_t TRACE_MAGIC = 0x52544d54;    // 按小端序存放时为"TMTR"
+const uint32_t TRACE_VERSION = 1;
+
+// 16字节的文件头
+struct trace_header
+{
+    uint32_t magic;         // 魔数
+    uint32_t version;       // 版本号
+    int64_t start;          // 录制开始时的timer_now()
+};
+
+// 16字节的轨迹记录
+struct trace_record
+{
+    uint32_t time;          // 相对开始时间的秒数
+    uint32_t id;            // 定时器编号，TICK记录中为0
+    uint32_t deadline;      // 相对开始时间的到期秒数，只有ADD和ADJUST记录有意义
+    uint32_t op_period;     // 低8位是操作类型，高24位是周期（秒），只有ADD记录有意义
+
+    trace_op op() const
+    {
+        return static_cast<trace_op>(op_period & 0xff);
+    }
+
+    int period() const
+    {
+        return static_cast<int>(op_period >> 8);
+    }
+};
+
+// 录制器：给引擎套上句柄接口，同时把每个操作写入轨迹文件
+template <template <typename> class Engine, typename T>
+class timer_recorder
+{
+public:
+    // 录制器写入out，out由调用者打开和关闭。其余参数原样转发给引擎
+    template <typename... Args>
+    explicit timer_recorder(FILE* out, Args&&... args)
+        : timers(std::forward<Args>(args)...), out(out), start(timer_now()), next_id(0), failed(false)
+    {
+        trace_header header = { TRACE_MAGIC, TRACE_VERSION, static_cast<int64_t>(start) };
+        failed = fwrite(&header, sizeof(header), 1, out) != 1;
+        buffer.reserve(BUFFER_RECORDS);
+    }
+
+    ~timer_recorder()
+    {
+        flush();
+    }
+
+    // 添加一个timeout秒后到期的定时器，period大于0时为周期定时器。引擎拒绝添加时返回INVALID_TIMER_HANDLE，
+    // 不占用编号，也不记录
+    timer_handle add_timer(int timeout, void (*cb)(T), T data, int period = 0)
+    {
+        context ctx = { this, next_id, cb, data };
+        timer_handle h = timers.add_timer(timeout, &timer_recorder::fire, ctx, period);
+        if(h == INVALID_TIMER_HANDLE)
+        {
+            return h;
+        }
+        ++next_id;
+        if(h.index >= ids.size())
+        {
+            ids.resize(h.index + 1);
+        }
+        ids[h.index] = ctx.id;
+        write(TRACE_ADD, ctx.id, timeout, period);
+        return h;
+    }
+
+    // 取消定时器，定时器已经到期或被删除时什么也不做，也不记录
+    void del_timer(timer_handle h)
+    {
+        if(!timers.valid(h))
+        {
+            return;
+        }
+        write(TRACE_CANCEL, ids[h.index], 0, 0);
+        timers.del_timer(h);
+    }
+
+    // 把定时器改为timeout秒后到期。定时器已经到期或被删除时返回false；引擎拒绝新的超时值时定时器已被
+    // 取消，记录为CANCEL
+    bool adjust_timer(timer_handle h, int timeout)
+    {
+        if(!timers.valid(h))
+        {
+            return false;
+        }
+        if(!timers.adjust_timer(h, timeout))
+        {
+            write(TRACE_CANCEL, ids[h.index], 0, 0);
+            return false;
+        }
+        write(TRACE_ADJUST, ids[h.index], timeout, 0);
+        return true;
+    }
+
+    bool valid(timer_handle h) const
+    {
+        return timers.valid(h);
+    }
+
+    int size() const
+    {
+        return timers.size();
+    }
+
+    // 先记录tick，到期的定时器在回调函数执行之前各记录一条FIRE
+    void tick()
+    {
+        write(TRACE_TICK, 0, 0, 0);
+        timers.tick();
+    }
+
+    // 把缓冲的记录写入文件
+    void flush()
+    {
+        if(!buffer.empty() && fwrite(&buffer[0], sizeof(trace_record), buffer.size(), out) != buffer.size())
+        {
+            failed = true;
+        }
+        buffer.clear();
+        fflush(out);
+    }
+
+    // 到目前为止写文件是否都成功
+    bool good() const
+    {
+        return !failed;
+    }
+
+private:
+    static const size_t BUFFER_RECORDS = 4096;  // 攒够这么多条记录再写文件
+
+    // 引擎节点携带的数据
+    struct context
+    {
+        timer_recorder* recorder;
+        uint32_t id;            // 定时器编号
+        void (*cb_func)(T);     // 定时器回调函数
+        T user_data;            // 用户数据
+    };
+
+    static void fire(context ctx)
+    {
+        ctx.recorder->write(TRACE_FIRE, ctx.id, 0, 0);
+        ctx.cb_func(ctx.user_data);
+    }
+
+    void write(trace_op op, uint32_t id, int timeout, int period)
+    {
+        trace_record r;
+        r.time = static_cast<uint32_t>(timer_now() - start);
+        r.id = id;
+        r.deadline = r.time + static_cast<uint32_t>(timeout);
+        r.op_period = (static_cast<uint32_t>(period) << 8) | op;
+        buffer.push_back(r);
+        if(buffer.size() >= BUFFER_RECORDS)
+        {
+            flush();
+        }
+    }
+
+private:
+    handle_timer_mgr<Engine, context> timers;  // 实际存放定时器的引擎
+    std::vector<uint32_t> ids;                 // 句柄下标对应的定时器编号
+    std::vector<trace_record> buffer;          // 尚未写入文件的记录
+    FILE* out;                                 // 轨迹文件
+    time_t start;                              // 录制开始的时间
+    uint32_t next_id;                          // 下一个定时器编号
+    bool failed;                               // 是否有写文件失败
+};
+
+// 回放时的定时器，引擎的用户数据指向它
+struct trace_timer
+{
+    void* node;             // 引擎中的节点，为nullptr表示定时器已经到期或被取消
+    int period;             // 周期（秒）
+};
+
+// 一种操作的耗时统计
+struct trace_latency
+{
+    long long count;        // 操作次数
+    double total_ns;        // 总耗时（纳秒）
+    double max_ns;          // 最大耗时（纳秒）
+    long long buckets[40];  // 第i个桶统计耗时在[2^(i-1), 2^i)纳秒之间的操作
+
+    void add(double ns)
+    {
+        ++count;
+        total_ns += ns;
+        max_ns = ns > max_ns ? ns : max_ns;
+        int i = 0;
+        while(i < 39 && ns >= static_cast<double>(1ll << i))
+        {
+            ++i;
+        }
+        ++buckets[i];
+    }
+
+    double mean_ns() const
+    {
+        return count ? total_ns / count : 0;
+    }
+
+    // 第q（0~1）分位数所在桶的上界（纳秒）
+    double percentile_ns(double q) const
+    {
+        long long target = static_cast<long long>(q * count);
+        long long seen = 0;
+        for(int i = 0; i < 40; ++i)
+        {
+            seen += buckets[i];
+            if(seen > target)
+            {
+                return static_cast<double>(1ll << i);
+            }
+        }
+        return max_ns;
+    }
+};
+
+// 回放结果
+struct trace_report
+{
+    bool ok;                    // 轨迹文件是否完整有效，引擎拒绝添加其中的定时器时也为false
+    long long records;          // 回放的记录条数
+    long long fires;            // 回放中实际到期的次数
+    long long recorded_fires;   // 轨迹中记录的到期次数，两者不同说明引擎的到期语义与录制时不同
+    double seconds;             // 执行引擎操作的总耗时（秒），不含读文件
+    double ops_per_second;      // 引擎操作的吞吐量，FIRE记录不计入
+    trace_latency add;          // 添加的耗时
+    trace_latency cancel;       // 取消的耗时
+    trace_latency adjust;       // 调整的耗时，引擎没有调整接口，以取消加添加实现
+    trace_latency tick;         // tick的耗时，包括其中执行回调函数的时间
+};
+
+namespace trace_detail
+{
+    inline long long& fires()
+    {
+        static thread_local long long n = 0;
+        return n;
+    }
+
+    // 回放时定时器到期的回调函数，一次性定时器的节点此后由引擎销毁
+    inline void on_fire(trace_timer* t)
+    {
+        if(t->period <= 0)
+        {
+            t->node = nullptr;
+        }
+        ++fires();
+    }
+}
+
+// 把in中的轨迹回放到引擎engine中，in由调用者打开和关闭
+template <typename Engine>
+trace_report replay_trace(Engine& engine, FILE* in)
+{
+    typedef timer_traits<Engine> traits;
+    typedef typename traits::timer_type timer_type;
+    typedef std::chrono::steady_clock steady;
+
+    trace_report report;
+    memset(&report, 0, sizeof(report));
+    trace_header header;
+    if(!in || fread(&header, sizeof(header), 1, in) != 1 || header.magic != TRACE_MAGIC
+        || header.version != TRACE_VERSION)
+    {
+        return report;
+    }
+
+    virtual_clock clock(static_cast<time_t>(header.start));
+    virtual_clock::scope use(clock);
+    trace_detail::fires() = 0;
+    std::deque<trace_timer> timers;     // 以定时器编号为下标，deque保证元素地址在扩充时不变
+    std::vector<trace_record> buffer(4096);
+    report.ok = true;
+
+    // 按字节读取，fread只在文件结束或出错时读不满，末尾不足一条记录的字节说明文件被截断
+    size_t got;
+    while((got = fread(&buffer[0], 1, buffer.size() * sizeof(trace_record), in)) > 0)
+    {
+        size_t n = got / sizeof(trace_record);
+        if(got % sizeof(trace_record))
+        {
+            report.ok = false;
+        }
+        for(size_t i = 0; i < n; ++i)
+        {
+            const trace_record& r = buffer[i];
+            clock.set(static_cast<time_t>(header.start) + r.time);
+            int timeout = static_cast<int>(r.deadline - r.time);
+            trace_op op = r.op();
+            if(op == TRACE_FIRE)
+            {
+                ++report.recorded_fires;
+                ++report.records;
+                continue;
+            }
+            // 编号按添加顺序分配，ADD记录的编号必须恰好等于此前ADD记录的条数，其他记录的编号必须已经出现过。
+            // 这样损坏的编号不会让timers无限扩充
+            if(op == TRACE_ADD ? r.id != timers.size() : op != TRACE_TICK && r.id >= timers.size())
+            {
+                report.ok = false;
+                continue;
+            }
+
+            steady::time_point t0 = steady::now();
+            switch(op)
+            {
+            case TRACE_ADD:
+            {
+                trace_timer empty = { nullptr, r.period() };
+                timers.push_back(empty);
+                trace_timer* t = &timers.back();
+                // 超时值为负时时间轮等引擎不创建定时器
+                timer_type* node = traits::add_timer(engine, timeout, &trace_detail::on_fire, t);
+                if(!node)
+                {
+                    report.ok = false;
+                    break;
+                }
+                node->period = t->period;
+                t->node = node;
+                break;
+            }
+            case TRACE_CANCEL:
+            {
+                trace_timer* t = &timers[r.id];
+                if(t->node)
+                {
+                    traits::del_timer(engine, static_cast<timer_type*>(t->node));
+                    t->node = nullptr;
+                }
+                break;
+            }
+            case TRACE_ADJUST:
+            {
+                trace_timer* t = &timers[r.id];
+                if(t->node)
+                {
+                    traits::del_timer(engine, static_cast<timer_type*>(t->node));
+                    timer_type* node = traits::add_timer(engine, timeout, &trace_detail::on_fire, t);
+                    t->node = node;
+                    if(!node)
+                    {
+                        report.ok = false;
+                        break;
+                    }
+                    node->period = t->period;
+                }
+                break;
+            }
+            case TRACE_TICK:
+                engine.tick();
+                break;
+            default:
+                report.ok = false;
+                break;
+            }
+            double ns = std::chrono::duration<double, std::nano>(steady::now() - t0).count();
+            report.seconds += ns * 1e-9;
+            ++report.records;
+
+            switch(op)
+            {
+            case TRACE_ADD:     report.add.add(ns);     break;
+            case TRACE_CANCEL:  report.cancel.add(ns);  break;
+            case TRACE_ADJUST:  report.adjust.add(ns);  break;
+            case TRACE_TICK:    report.tick.add(ns);    break;
+            default:                                    break;
+            }
+        }
+    }
+
+    if(ferror(in))
+    {
+        report.ok = false;
+    }
+    report.fires = trace_detail::fires();
+    long long ops = report.add.count + report.cancel.count + report.adjust.count + report.tick.count;
+    report.ops_per_second = report.seconds > 0 ? ops / report.seconds : 0;
+
+    // 取消回放结束时仍然存活的定时器
+    for(size_t i = 0; i < timers.size(); ++i)
+    {
+        if(timers[i].node)
+        {
+            traits::del_timer(engine, static_cast<timer_type*>(timers[i].node));
+        }
+    }
+    return report;
+}
+
+#endif
@@ -0,0 +1,28 @@
+/*
+    定时器引擎的统一适配接口。三种定时器的添加方式各不相同：升序链表和时间堆由调用者创建节点并填写
+    绝对超时时间，时间轮则根据相对超时值自己创建节点。timer_traits把它们统一成“在timeout秒后以data
+    调用cb”和“取消定时器”两个操作，协程等需要同时支持多种引擎的上层设施只依赖这个接口。
+
+    每个引擎在自己的头文件中特化timer_traits，特化需要提供：
+        typedef ... timer_type;                                                 // 引擎的定时器节点类型
+        static timer_type* add_timer(Engine&, int timeout, void (*cb)(T), T data); // timeout以秒为单位
+        static void del_timer(Engine&, timer_type*);                            // 取消尚未到期的定时器
+
+    所有引擎都在执行周期定时器的回调函数之前就把它以下一次的超时时间重新入队，所以回调函数可以调用
+    del_timer结束这个周期定时器；一次性定时器在执行回调函数之前已经离开引擎并清空了回调函数，回调函数
+    对它自己调用del_timer是空操作，节点仍由引擎在回调函数返回后销毁。
+
+    引擎只对用户数据类型T模板化，回调函数固定为函数指针void (*)(T)，没有再加一个函子类型的模板参数：
+    时间堆等几个引擎用空的cb_func标记被延迟销毁的节点，函子没有这样的空状态；handle_timer_mgr、
+    timer_recorder等上层设施以template <typename> class接收引擎，多一个模板参数（即使有默认值）在
+    C++17之前就不能再传给它们。回调函数因此不能内联，每次到期多一次间接调用，和执行回调函数本身的
+    开销相比可以忽略。需要携带状态的回调函数把状态放进T即可。
+*/
+
+#ifndef TIMER_TRAITS_HPP
+#define TIMER_TRAITS_HPP
+
+template <typename Engine>
+struct timer_traits;
+
+#endif
@@ -0,0 +1,235 @@
+/*
+    值类型时间堆：time_heap的堆数组里存放的是指针，每个heap_timer都要单独new出来，比较超时时间时要沿着
+    指针跳到分散在各处的节点上。值类型时间堆把定时器记录（超时时间、周期、回调函数、用户数据）直接按值
+    存放在连续的堆数组中，添加定时器不再分配节点，上虑和下虑只在这一块连续内存里移动记录。
+
+    记录在堆中的位置会随着上虑和下虑不断变化，所以调用者拿到的不是指针，而是一个带代数的句柄timer_handle。
+    句柄通过槽数组映射到记录当前所在的下标，记录每移动一次就更新一次映射，删除和调整定时器时据此直接
+    定位，不需要延迟销毁。定时器到期或被删除后句柄随即失效，之后再用它删除或调整定时器都是空操作。
+
+    从执行效率来看：
+        添加一个定时器的时间复杂度O(logn)，不分配内存（堆数组扩容除外）
+        删除一个定时器的时间复杂度O(logn)
+        调整一个定时器的时间复杂度O(logn)
+        执行一个定时器的时间复杂度O(logn)
+*/
+
+#ifndef VALUE_HEAP_TIMER_HPP
+#define VALUE_HEAP_TIMER_HPP
+
+#include <time.h>
+#include <vector>
+#include "timer_clock.hpp"
+#include "timer_handle.hpp"
+#include "timer_stats.hpp"
+
+// 值类型时间堆
+template <typename T>
+class value_heap
+{
+public:
+    explicit value_heap(int cap = 64)
+    {
+        heap.reserve(cap);
+    }
+
+    // 添加一个timeout秒后到期的定时器，period大于0时为周期定时器，返回它的句柄
+    timer_handle add_timer(int timeout, void (*cb)(T), T data, time_t period = 0)
+    {
+        timer_handle h = pos.insert(static_cast<int>(heap.size()));
+        entry e;
+        e.expire = timer_now() + timeout;
+        e.period = period;
+        e.cb_func = cb;
+        e.user_data = data;
+        e.index = h.index;
+        heap.push_back(e);
+        percolate_up(static_cast<int>(heap.size()) - 1);
+        stats.on_add();
+        return h;
+    }
+
+    // 删除目标定时器，定时器已经到期或被删除时什么也不做
+    void del_timer(timer_handle h)
+    {
+        int* hole = pos.get(h);
+        if(!hole)
+        {
+            return;
+        }
+        remove_at(*hole);
+        pos.erase(h);
+        stats.on_cancel();
+    }
+
+    // 把目标定时器的超时时间改为timeout秒之后，定时器已经到期或被删除时什么也不做
+    void adjust_timer(timer_handle h, int timeout)
+    {
+        int* p = pos.get(h);
+        if(!p)
+        {
+            return;
+        }
+        int hole = *p;
+        time_t old = heap[hole].expire;
+        heap[hole].expire = timer_now() + timeout;
+        if(heap[hole].expire < old)
+        {
+            percolate_up(hole);
+        }
+        else
+        {
+            percolate_down(hole);
+        }
+    }
+
+    // 句柄是否仍然指向一个尚未到期的定时器
+    bool valid(timer_handle h) const
+    {
+        return pos.get(h) != nullptr;
+    }
+
+    // 目标定时器的超时时间，调用者需保证句柄有效
+    time_t expire_of(timer_handle h) const
+    {
+        return heap[*pos.get(h)].expire;
+    }
+
+    // 堆顶定时器的句柄，堆为空时返回INVALID_TIMER_HANDLE
+    timer_handle top() const
+    {
+        return heap.empty() ? INVALID_TIMER_HANDLE : pos.handle_of(heap[0].index);
+    }
+
+    bool empty() const
+    {
+        return heap.empty();
+    }
+
+    int size() const
+    {
+        return static_cast<int>(heap.size());
+    }
+
+    // 心搏函数
+    void tick()
+    {
+        timer_stats::tick_scope scope(stats);
+        time_t cur = timer_now();
+        while(!heap.empty() && heap[0].expire <= cur)
+        {
+            // 回调函数可能添加定时器使堆数组重新分配，所以先把回调函数和用户数据复制出来
+            void (*cb)(T) = heap[0].cb_func;
+            T data = heap[0].user_data;
+            // 周期定时器的条目原地推迟超时时间后下虑，句柄保持不变
+            if(heap[0].period > 0)
+            {
+                entry& e = heap[0];
+                e.expire = timer_next_expire(e.expire, e.period, cur);
+                percolate_down(0);
+                stats.on_fire(true);
+                cb(data);
+                continue;
+            }
+            // 一次性定时器先从堆中移除并回收句柄，再执行其中的任务
+            timer_handle h = pos.handle_of(heap[0].index);
+            remove_at(0);
+            pos.erase(h);
+            stats.on_fire(false);
+            cb(data);
+        }
+    }
+
+    // 运行统计的快照
+    timer_stats_snapshot get_stats() const
+    {
+        return stats.snapshot();
+    }
+
+private:
+    // 堆数组中的定时器记录，超时时间放在最前面，比较时只读取每条记录的第一个字
+    struct entry
+    {
+        time_t expire;          // 定时器生效的绝对时间
+        time_t period;          // 周期定时器的重复间隔（秒），为0表示一次性定时器
+        void (*cb_func)(T);     // 定时器回调函数
+        T user_data;            // 用户数据
+        uint32_t index;         // 定时器句柄的下标
+    };
+
+    // 把第hole条记录移出堆：用最后一条记录填补空位，再视情况上虑或下虑
+    void remove_at(int hole)
+    {
+        int last = static_cast<int>(heap.size()) - 1;
+        if(hole != last)
+        {
+            heap[hole] = heap[last];
+            pos.at(heap[hole].index) = hole;
+        }
+        heap.pop_back();
+        if(hole < last)
+        {
+            if(hole > 0 && heap[hole].expire < heap[(hole-1)/2].expire)
+            {
+                percolate_up(hole);
+            }
+            else
+            {
+                percolate_down(hole);
+            }
+        }
+    }
+
+    // 最小堆的上虑操作，记录每移动一次就更新它的句柄映射
+    void percolate_up(int hole)
+    {
+        entry temp = heap[hole];
+        int parent = 0;
+        for(; hole > 0; hole = parent)
+        {
+            parent = (hole-1)/2;
+            if(heap[parent].expire <= temp.expire)
+            {
+                break;
+            }
+            heap[hole] = heap[parent];
+            pos.at(heap[hole].index) = hole;
+        }
+        heap[hole] = temp;
+        pos.at(temp.index) = hole;
+    }
+
+    // 最小堆的下虑操作
+    void percolate_down(int hole)
+    {
+        int size = static_cast<int>(heap.size());
+        entry temp = heap[hole];
+        int child = 0;
+        for(; hole*2+1 <= size - 1; hole = child)
+        {
+            child = hole*2+1;
+            if(child < size - 1 && heap[child + 1].expire < heap[child].expire)
+            {
+                ++child;
+            }
+            if(heap[child].expire < temp.expire)
+            {
+                heap[hole] = heap[child];
+                pos.at(heap[hole].index) = hole;
+            }
+            else
+            {
+                break;
+            }
+        }
+        heap[hole] = temp;
+        pos.at(temp.index) = hole;
+    }
+
+private:
+    std::vector<entry> heap;        // 堆数组，按值存放定时器记录
+    handle_slots<int> pos;          // 句柄到堆数组下标的映射
+    timer_stats stats;              // 运行统计
+};
+
+#endif
@@ -0,0 +1,280 @@
+/*
+    多叉时间堆：时间堆是二叉堆，n个定时器时树高为log2(n)，下虑时每一层都可能访问一条新的缓存行。多叉堆
+    让每个节点有D个孩子（默认8个），树高降为log_D(n)；每个节点的D个孩子的key连续存放，D=8时恰好占满
+    一条64字节的缓存行，下虑时每一层只需要在这一行里找出最小的孩子。
+
+    key与时间堆相同，高32位是超时时间、低32位是入堆序号，两个key不会相等，超时时间相同的定时器按入堆的
+    先后到期。key和定时器指针分成两个平行的数组存放，找最小孩子时只读取key数组。为了让每组孩子从对齐的
+    位置开始，数组的前D-1个位置空置，逻辑下标为i的元素存放在第i+D-1个位置上。
+
+    在D个连续的64位整数中找最小值的下标可以向量化：编译时开启AVX2时每次比较4个key，开启SSE4.2时每次
+    比较2个key（pcmpgtq），否则使用标量实现。pcmpgtq是有符号比较，所以key在存入数组时翻转了最高位。
+
+    定时器节点沿用时间堆的heap_timer，延迟销毁、压缩和tick都继承自lazy_heap_base，与时间堆相同。
+
+    从执行效率来看：
+        添加一个定时器的时间复杂度O(log_D(n))
+        删除一个定时器的时间复杂度O(1)
+        执行一个定时器的时间复杂度O(D*log_D(n))，其中找最小孩子的D次比较由向量指令完成
+*/
+
+#ifndef WIDE_HEAP_TIMER_HPP
+#define WIDE_HEAP_TIMER_HPP
+
+#include <stdint.h>
+#include <time.h>
+#include <exception>
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+#include "time_heap_timer.hpp"
+#include "timer_clock.hpp"
+#include "timer_group.hpp"
+#include "timer_stats.hpp"
+#include "timer_traits.hpp"
+
+namespace wide_heap_detail
+{
+    // 标量实现：在keys[0]~keys[n-1]中找出最小值的下标
+    inline int min_index_scalar(const int64_t* keys, int n)
+    {
+        int best = 0;
+        for(int i = 1; i < n; ++i)
+        {
+            best = keys[i] < keys[best] ? i : best;
+        }
+        return best;
+    }
+
+    // 在keys[0]~keys[n-1]中找出最小值的下标，keys中的值互不相等。n是向量宽度的整数倍时使用向量指令
+    inline int min_index(const int64_t* keys, int n)
+    {
+#if defined(__AVX2__)
+        if(n % 4 == 0)
+        {
+            // 先逐列取出n/4个向量的最小值，再在4个通道之间两两归约，最后用相等比较找出最小值所在的位置
+            __m256i min = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys));
+            for(int i = 4; i < n; i += 4)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+                min = _mm256_blendv_epi8(min, v, _mm256_cmpgt_epi64(min, v));
+            }
+            __m256i swap = _mm256_permute4x64_epi64(min, 0x4e);
+            min = _mm256_blendv_epi8(min, swap, _mm256_cmpgt_epi64(min, swap));
+            swap = _mm256_shuffle_epi32(min, 0x4e);
+            min = _mm256_blendv_epi8(min, swap, _mm256_cmpgt_epi64(min, swap));
+            for(int i = 0; i < n; i += 4)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+                int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, min)));
+                if(mask)
+                {
+                    return i + __builtin_ctz(mask);
+                }
+            }
+        }
+#elif defined(__SSE4_2__)
+        if(n % 2 == 0)
+        {
+            __m128i min = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys));
+            for(int i = 2; i < n; i += 2)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+                min = _mm_blendv_epi8(min, v, _mm_cmpgt_epi64(min, v));
+            }
+            __m128i swap = _mm_shuffle_epi32(min, 0x4e);
+            min = _mm_blendv_epi8(min, swap, _mm_cmpgt_epi64(min, swap));
+            for(int i = 0; i < n; i += 2)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+                int mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(v, min)));
+                if(mask)
+                {
+                    return i + __builtin_ctz(mask);
+                }
+            }
+        }
+#endif
+        return min_index_scalar(keys, n);
+    }
+}
+
+// 多叉时间堆，D是每个节点的孩子数
+template <typename T, int D = 8>
+class wide_heap : public lazy_heap_base<wide_heap<T, D>, T>
+{
+    typedef lazy_heap_base<wide_heap, T> base;
+    friend class lazy_heap_base<wide_heap, T>;
+    using base::cur_size;
+public:
+    typedef heap_timer<T> timer_type;
+
+    explicit wide_heap(int cap = 64) : key_buf(nullptr), keys(nullptr), timers(nullptr), capacity(0)
+    {
+        reallocate(cap > 0 ? cap : 1);
+    }
+
+    // 销毁多叉时间堆
+    ~wide_heap()
+    {
+        this->destroy_timers();
+        delete []key_buf;
+        delete []timers;
+    }
+
+    // 添加目标定时器
+    void add_timer(timer_type* timer)
+    {
+        this->push_timer(timer);
+    }
+
+private:
+    // 翻转key的最高位，使有符号比较的结果与无符号比较一致
+    static int64_t signed_key(uint64_t key)
+    {
+        return static_cast<int64_t>(key ^ 0x8000000000000000ull);
+    }
+
+    timer_type* timer_at(int i) const
+    {
+        return timers[i];
+    }
+
+    void reserve(int n)
+    {
+        if(n > capacity)
+        {
+            reallocate(2*capacity > n ? 2*capacity : n);
+        }
+    }
+
+    void push(int hole, uint64_t key, timer_type* timer)
+    {
+        percolate_up(hole, signed_key(key), timer);
+    }
+
+    void rekey_top(uint64_t key)
+    {
+        keys[0] = signed_key(key);
+        percolate_down(0);
+    }
+
+    // 用最后一个元素填补堆顶的空位并下虑
+    void fill_top(int last)
+    {
+        keys[0] = keys[last];
+        timers[0] = timers[last];
+        if(cur_size > 0)
+        {
+            percolate_down(0);
+        }
+    }
+
+    void move_entry(int from, int to)
+    {
+        keys[to] = keys[from];
+        timers[to] = timers[from];
+    }
+
+    void heapify()
+    {
+        for(int i = (cur_size - 2) / D; i >= 0; --i)
+        {
+            percolate_down(i);
+        }
+    }
+
+    void percolate_up(int hole, int64_t key, timer_type* timer)
+    {
+        while(hole > 0)
+        {
+            int parent = (hole - 1) / D;
+            if(keys[parent] < key)
+            {
+                break;
+            }
+            keys[hole] = keys[parent];
+            timers[hole] = timers[parent];
+            hole = parent;
+        }
+        keys[hole] = key;
+        timers[hole] = timer;
+    }
+
+    // 多叉堆的下虑操作，孩子满D个时用向量指令找最小的孩子
+    void percolate_down(int hole)
+    {
+        int64_t key = keys[hole];
+        timer_type* timer = timers[hole];
+        for(;;)
+        {
+            int first = hole * D + 1;
+            if(first >= cur_size)
+            {
+                break;
+            }
+            int n = cur_size - first < D ? cur_size - first : D;
+            int child = first + (n == D ? wide_heap_detail::min_index(keys + first, D)
+                                        : wide_heap_detail::min_index_scalar(keys + first, n));
+            if(keys[child] > key)
+            {
+                break;
+            }
+            keys[hole] = keys[child];
+            timers[hole] = timers[child];
+            hole = child;
+        }
+        keys[hole] = key;
+        timers[hole] = timer;
+    }
+
+    // 调整数组容量。keys指向key_buf中按64字节对齐后再偏移D-1个位置的地方，使每组孩子从对齐的位置开始
+    void reallocate(int new_capacity)
+    {
+        int64_t* new_buf = new int64_t[new_capacity + D - 1 + 8];
+        uintptr_t addr = reinterpret_cast<uintptr_t>(new_buf);
+        int64_t* aligned = reinterpret_cast<int64_t*>((addr + 63) & ~static_cast<uintptr_t>(63));
+        int64_t* new_keys = aligned + D - 1;
+        timer_type** new_timers = new timer_type*[new_capacity];
+        for(int i = 0; i < cur_size; ++i)
+        {
+            new_keys[i] = keys[i];
+            new_timers[i] = timers[i];
+        }
+        delete []key_buf;
+        delete []timers;
+        key_buf = new_buf;
+        keys = new_keys;
+        timers = new_timers;
+        capacity = new_capacity;
+    }
+
+private:
+    int64_t* key_buf;       // key数组实际分配的内存
+    int64_t* keys;          // key数组，keys[i]是逻辑下标为i的元素的key
+    timer_type** timers;    // 与key数组平行的定时器指针数组
+    int capacity;           // 数组的容量
+};
+
+// 多叉时间堆的统一适配接口
+template <typename T, int D>
+struct timer_traits<wide_heap<T, D> >
+{
+    typedef heap_timer<T> timer_type;
+
+    static timer_type* add_timer(wide_heap<T, D>& heap, int timeout, void (*cb)(T), T data)
+    {
+        timer_type* timer = new timer_type(timeout);
+        timer->cb_func = cb;
+        timer->user_data = data;
+        heap.add_timer(timer);
+        return timer;
+    }
+
+    static void del_timer(wide_heap<T, D>& heap, timer_type* timer)
+    {
+        heap.del_timer(timer);
+    }
+};
+
+#endif